@@ -0,0 +1,98 @@
+#pragma once
+#include <chrono>
+#include <functional>
+
+#include <Logger.h>
+#include <Machine.h>
+
+namespace turing::bench {
+
+using Clock = std::chrono::steady_clock;
+using machine::Size;
+using utils::Logger;
+
+namespace constants {
+constexpr auto MeasurementFormat = "{} n={} time={}s ns/op={}";
+constexpr auto MemoryFormat = "{} bytes={}";
+constexpr auto JsonFormat =
+    "{\"name\":\"{}\",\"n\":{},\"seconds\":{},\"nsPerOp\":{},"
+    "\"bytes\":{}}";
+} // namespace constants
+
+// Measurement is either a timing, or the memory something held when bytes
+// is set.
+struct Measurement {
+  std::string name;
+  Size size; // number of operations timed, e.g. cells swept or steps run
+  double seconds;
+  Size bytes = 0;
+
+  auto nanosPerOp() const -> double {
+    return size == 0 ? 0 : seconds * 1e9 / static_cast<double>(size);
+  }
+
+  auto toString() const -> std::string {
+    if (bytes != 0) {
+      return utils::format(constants::MemoryFormat, name, bytes);
+    }
+    return utils::format(constants::MeasurementFormat, name, size, seconds,
+                         nanosPerOp());
+  }
+
+  // Benchmark names hold nothing that needs escaping.
+  auto toJson() const -> std::string {
+    return utils::format(constants::JsonFormat, name, size, seconds,
+                         nanosPerOp(), bytes);
+  }
+};
+
+struct Runner {
+private:
+  std::vector<Measurement> measurements;
+  const Logger &logger;
+
+public:
+  Runner() : logger(Logger::instance()) {}
+
+  auto measure(std::string_view name, Size size,
+               const std::function<void()> &fn) -> void {
+    auto begin = Clock::now();
+    fn();
+    auto elapsed = std::chrono::duration<double>(Clock::now() - begin);
+    auto &measurement = measurements.emplace_back(
+        Measurement{std::string{name}, size, elapsed.count()});
+    logger.info(measurement.toString());
+  }
+
+  auto memory(std::string_view name, Size bytes) -> void {
+    auto &measurement =
+        measurements.emplace_back(Measurement{std::string{name}, 0, 0, bytes});
+    logger.info(measurement.toString());
+  }
+
+  // Every measurement so far as a JSON array, one object per line.
+  auto json() const -> std::string {
+    auto lines = std::vector<std::string>{};
+    for (const auto &measurement : measurements) {
+      lines.push_back(measurement.toJson());
+    }
+    return "[\n" + utils::join(lines, ",\n") + "\n]\n";
+  }
+
+  auto results() const -> const std::vector<Measurement> & {
+    return measurements;
+  }
+};
+
+struct Benchmark {
+  std::string_view name;
+  std::function<void(Runner &)> run;
+};
+
+// Keeps the compiler from discarding a computed value: the empty asm
+// claims to read it and to touch memory.
+template <typename T> inline auto keep(const T &value) -> void {
+  asm volatile("" : : "g"(value) : "memory");
+}
+
+} // namespace turing::bench
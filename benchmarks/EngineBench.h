@@ -0,0 +1,73 @@
+#pragma once
+#include <Bench.h>
+#include <Machines.h>
+#include <Parser.h>
+
+namespace turing::bench {
+
+using parser::Parser;
+using simulator::Engine;
+using simulator::Options;
+using simulator::Simulator;
+
+// Marks the 1s of its input one at a time, walking to the far end of the
+// tape and back after each, which takes about 2n^2 steps.
+constexpr auto Zigzag = std::string_view{
+    "#Q = {q0, r, b, halt}\n#S = {1}\n#G = {1, x, _}\n#q0 = q0\n"
+    "#B = _\n#F = {halt}\n#N = 1\n"
+    "q0 x x r q0\nq0 1 x r r\nq0 _ _ * halt\n"
+    "r * * r r\nr _ _ l b\nb * * l b\nb _ _ r q0\n"};
+
+// Runs the same machine on each engine that steps every cell.
+inline auto engineSteps(Runner &runner) -> void {
+  auto program = Parser::fromSource(Zigzag).program().unwrap();
+
+  auto input = std::string(3000, '1');
+  for (auto engine : {Engine::Table, Engine::Threaded}) {
+    auto name = engine == Engine::Table ? "engine/table" : "engine/threaded";
+    auto options = Options{};
+    options.engine = engine;
+    auto simulator = Simulator::of(program, input, options).unwrap();
+    simulator.execute();
+    auto steps = simulator.steps();
+    simulator.reset(input);
+    runner.measure(name, steps, [&simulator] {
+      simulator.execute();
+      keep(simulator.steps());
+    });
+  }
+}
+
+// Runs the wide copy on one to 48 tapes, each step reading and writing every
+// tape, on each engine that takes the machine. Past 32 tapes the heads read
+// more than 64 bits and the table is laid out wide.
+inline auto engineTapes(Runner &runner) -> void {
+  constexpr auto Cells = Size{2000000};
+  for (auto tapes : {Size{1}, Size{2}, Size{4}, Size{8}, Size{16}, Size{32},
+                     Size{48}}) {
+    auto machine = wideCopy(tapes, Cells / tapes);
+    auto program = Parser::fromSource(machine.source).program().unwrap();
+    for (auto engine : {Engine::Table, Engine::Threaded}) {
+      auto options = Options{};
+      options.engine = engine;
+      auto simulator = Simulator::of(program, machine.input, options);
+      if (!simulator) {
+        continue;
+      }
+      auto &run = *simulator;
+      run.execute();
+      auto steps = run.steps();
+      run.reset(machine.input);
+      runner.measure(utils::format("engine/tapes/{}/{}",
+                                   engine == Engine::Table ? "table"
+                                                           : "threaded",
+                                   tapes),
+                     steps, [&run] {
+                       run.execute();
+                       keep(run.steps());
+                     });
+    }
+  }
+}
+
+} // namespace turing::bench
@@ -0,0 +1,203 @@
+#pragma once
+#include <fstream>
+#include <optional>
+#include <random>
+#include <sstream>
+
+#include <Bench.h>
+
+namespace turing::bench {
+
+// Reference is a machine of the benchmark suite with the input it runs on.
+struct Reference {
+  std::string name;
+  std::string source;
+  std::string input;
+};
+
+// Header of a machine source; states, symbols and finals are listed as they
+// go between the braces.
+inline auto sourceHeader(std::string_view states, std::string_view symbols,
+                         std::string_view tapeSymbols, std::string_view initial,
+                         std::string_view finals, Size tapes) -> std::string {
+  return utils::format("#Q = {{}}\n#S = {{}}\n#G = {{}}\n#q0 = {}\n#B = _\n"
+                       "#F = {{}}\n#N = {}\n",
+                       states, symbols, tapeSymbols, initial, finals, tapes);
+}
+
+// Random symbols drawn from alphabet, the same for the same seed.
+inline auto randomInput(std::string_view alphabet, Size length,
+                        unsigned seed = 1) -> std::string {
+  auto engine = std::mt19937(seed);
+  auto pick = std::uniform_int_distribution<Size>(0, alphabet.size() - 1);
+  auto input = std::string(length, ' ');
+  for (auto &ch : input) {
+    ch = alphabet[pick(engine)];
+  }
+  return input;
+}
+
+// Adds two unary numbers 1^n+1^n by joining them, about 2n steps.
+inline auto unaryAdder(Size n) -> Reference {
+  auto source = sourceHeader("q0,q1,q2,halt", "1,+", "1,+,_", "q0", "halt", 1);
+  source += "q0 1 1 r q0\nq0 + 1 r q1\nq1 1 1 r q1\nq1 _ _ l q2\n"
+            "q2 1 _ * halt\n";
+  auto operand = std::string(n, '1');
+  return {utils::format("unary-add/{}", n), source, operand + '+' + operand};
+}
+
+// Adds two binary numbers of n bits, x+y, on two tapes: y is moved to the
+// second tape, then both are added from their last bit on with the carry in
+// the state, leaving the sum on the first tape. About 5n steps.
+inline auto binaryAdder(Size n) -> Reference {
+  auto source = sourceHeader("q0,cp,back,c0,c1,halt", "0,1,+", "0,1,+,_", "q0",
+                             "halt", 2);
+  source += "q0 0_ 0_ r* q0\nq0 1_ 1_ r* q0\nq0 +_ __ r* cp\n"
+            "cp 0_ _0 rr cp\ncp 1_ _1 rr cp\ncp __ __ ll back\n";
+  for (auto y : {'0', '1'}) {
+    source += utils::format("back _{} _{} l* back\n", y, y);
+    for (auto x : {'0', '1'}) {
+      source += utils::format("back {}{} {}{} ** c0\n", x, y, x, y);
+    }
+  }
+  // blanks on either side of the operands count as 0
+  constexpr auto Digits = std::string_view{"01_"};
+  for (auto carry = 0; carry < 2; carry++) {
+    for (auto x : Digits) {
+      for (auto y : Digits) {
+        if (x == '_' && y == '_') {
+          source += utils::format("c{} __ {}_ ** halt\n", carry,
+                                  carry == 0 ? '_' : '1');
+          continue;
+        }
+        auto sum = (x == '1') + (y == '1') + carry;
+        source += utils::format("c{} {}{} {}{} ll c{}\n", carry, x, y,
+                                sum % 2 == 0 ? '0' : '1', y, sum / 2);
+      }
+    }
+  }
+  auto x = '1' + randomInput("01", n - 1, 1);
+  auto y = '1' + randomInput("01", n - 1, 2);
+  return {utils::format("binary-add/{}", n), source, x + '+' + y};
+}
+
+// The copy machine of programs/case1.tm on n random bits, if the sample is
+// where the build put it.
+inline auto copyMachine(Size n) -> std::optional<Reference> {
+  auto fs = std::ifstream(std::string{TURING_PROGRAMS_DIR} + "/case1.tm");
+  if (!fs.is_open()) {
+    return std::nullopt;
+  }
+  auto source = std::ostringstream{};
+  source << fs.rdbuf();
+  return Reference{utils::format("copy/{}", n), source.str(),
+                   randomInput("01", n)};
+}
+
+// Checks a palindrome of length n on one tape by crossing off its first and
+// last symbols in turn, about n^2/2 steps.
+inline auto palindrome(Size n) -> Reference {
+  auto source = sourceHeader("q0,ra,rb,ca,cb,back,halt", "a,b", "a,b,_", "q0",
+                             "halt", 1);
+  source += "q0 a _ r ra\nq0 b _ r rb\nq0 _ _ * halt\n";
+  for (auto c : {'a', 'b'}) {
+    source += utils::format("r{} a a r r{}\nr{} b b r r{}\nr{} _ _ l c{}\n", c,
+                            c, c, c, c, c);
+    source += utils::format("c{} {} _ l back\nc{} _ _ * halt\n", c, c, c);
+  }
+  source += "back a a l back\nback b b l back\nback _ _ r q0\n";
+  auto half = randomInput("ab", n / 2);
+  return {utils::format("palindrome/{}", n), source,
+          half + std::string(half.rbegin(), half.rend())};
+}
+
+// Checks a palindrome of length n on two tapes: the input is copied to the
+// second tape and read back against the first, about 3n steps.
+inline auto palindrome2(Size n) -> Reference {
+  auto source =
+      sourceHeader("cp,rew,cmp,halt", "a,b", "a,b,_", "cp", "halt", 2);
+  source += "cp a_ aa rr cp\ncp b_ bb rr cp\ncp __ __ ll rew\nrew __ __ ** halt\n";
+  for (auto x : {'a', 'b'}) {
+    for (auto y : {'a', 'b'}) {
+      source += utils::format("rew {}{} {}{} l* rew\n", x, y, x, y);
+    }
+    source += utils::format("rew _{} _{} r* cmp\n", x, x);
+    source += utils::format("cmp {}{} {}{} rl cmp\n", x, x, x, x);
+  }
+  source += "cmp __ __ ** halt\n";
+  auto half = randomInput("ab", n / 2);
+  return {utils::format("palindrome2/{}", n), source,
+          half + std::string(half.rbegin(), half.rend())};
+}
+
+// The busy beaver champion with the given number of states, 2 to 5, run on
+// a blank tape. The 5-state one takes 47,176,870 steps.
+inline auto busyBeaver(Size states) -> Reference {
+  // what every state does on 0 and on 1, as in the literature: write, move
+  // and next state, with H the halting state
+  constexpr auto Tables = std::array<std::string_view, 4>{
+      "1RB1LB 1LA1RH",
+      "1RB1RH 1LB0RC 1LC1LA",
+      "1RB1LB 1LA0LC 1RH1LD 1RD0RA",
+      "1RB1LC 1RC1RB 1RD0LE 1LA1LD 1RH0LA",
+  };
+  auto table = Tables[states - 2];
+  auto names = std::vector<std::string>{};
+  for (auto state = Size{0}; state < states; state++) {
+    names.emplace_back(1, static_cast<char>('A' + state));
+  }
+  names.emplace_back("H");
+  auto source = sourceHeader(utils::join(names, ','), "1", "1,_", "A", "H", 1);
+  for (auto state = Size{0}; state < states; state++) {
+    for (auto read = Size{0}; read < 2; read++) {
+      auto rule = table.substr(state * 7 + read * 3, 3);
+      source += utils::format("{} {} {} {} {}\n", names[state],
+                              read == 0 ? '_' : '1',
+                              rule[0] == '0' ? '_' : '1',
+                              rule[1] == 'L' ? 'l' : 'r', rule[2]);
+    }
+  }
+  return {utils::format("busy-beaver/{}", states), source, ""};
+}
+
+// Copies n random bits from the first tape onto every other one of tapes
+// tapes at once and walks all heads back, 2n steps that each read and write
+// every tape.
+inline auto wideCopy(Size tapes, Size n) -> Reference {
+  auto source =
+      sourceHeader("cp,back,halt", "0,1", "0,1,_", "cp", "halt", tapes);
+  auto blanks = std::string(tapes, '_');
+  auto right = std::string(tapes, 'r');
+  auto left = std::string(tapes, 'l');
+  for (auto bit : {'0', '1'}) {
+    auto read = bit + std::string(tapes - 1, '_');
+    auto all = std::string(tapes, bit);
+    source += utils::format("cp {} {} {} cp\n", read, all, right);
+    source += utils::format("back {} {} {} back\n", all, all, left);
+  }
+  source += utils::format("cp {} {} {} back\n", blanks, blanks, left);
+  source += utils::format("back {} {} {} halt\n", blanks, blanks, right);
+  return {utils::format("wide-copy/{}x{}", tapes, n), source,
+          randomInput("01", n)};
+}
+
+// Every machine of the suite, sized so that one run takes a few million
+// steps.
+inline auto referenceMachines() -> std::vector<Reference> {
+  auto machines = std::vector<Reference>{
+      unaryAdder(1000000), binaryAdder(200000), palindrome(2000),
+      palindrome2(1000000),
+  };
+  if (auto copy = copyMachine(1000000)) {
+    machines.push_back(std::move(*copy));
+  }
+  for (auto states = Size{2}; states <= 5; states++) {
+    machines.push_back(busyBeaver(states));
+  }
+  for (auto tapes : {Size{2}, Size{8}, Size{32}}) {
+    machines.push_back(wideCopy(tapes, 1000000 / tapes));
+  }
+  return machines;
+}
+
+} // namespace turing::bench
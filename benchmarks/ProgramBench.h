@@ -0,0 +1,77 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+
+#include <Bench.h>
+#include <Parser.h>
+
+namespace turing::bench {
+
+using machine::Program;
+using parser::Parser;
+
+// Writes a two-tape machine with ten transitions per state.
+inline auto writeMachine(const std::string &path, Size states) -> void {
+  constexpr auto Symbols = std::string_view{"abcdefghij_"};
+  auto fs = std::ofstream(path);
+  for (auto i = Size{0}; i < states; i += 50) {
+    auto names = std::vector<std::string>{};
+    for (auto j = i; j < std::min(states, i + 50); j++) {
+      names.emplace_back(utils::format("s{}", j));
+    }
+    fs << "#Q = {" << utils::join(names, ',') << "}\n";
+  }
+  fs << "#S = {a,b}\n#G = {a,b,c,d,e,f,g,h,i,j,_}\n#q0 = s0\n#B = _\n"
+     << "#F = {s0}\n#N = 2\n";
+  for (auto i = Size{0}; i < states; i++) {
+    for (auto k = Size{0}; k < 10; k++) {
+      fs << 's' << i << ' ' << Symbols[k] << Symbols[(k + i) % 11] << ' '
+         << Symbols[(k * 7) % 10] << Symbols[i % 10] << " rl s"
+         << (i * 31 + k) % states << '\n';
+    }
+  }
+}
+
+// Compares starting from source, which parses and compiles the machine, with
+// mapping an image written by --compile.
+inline auto programImage(Runner &runner) -> void {
+  auto directory = std::filesystem::temp_directory_path();
+  for (auto states : {Size{1000}, Size{10000}}) {
+    auto source = (directory / "turing_bench.tm").string();
+    auto image = (directory / "turing_bench.tmc").string();
+    writeMachine(source, states);
+
+    auto compiled = std::shared_ptr<const Program>{};
+    runner.measure("program/parse", states, [&source, &compiled] {
+      auto parser = std::move(Parser::open(source, "").unwrap());
+      compiled = *parser.program();
+      keep(compiled->actions());
+    });
+    {
+      auto fs = std::ofstream(image, std::ios::binary);
+      compiled->save(fs);
+    }
+    runner.measure("program/load", states, [&image] {
+      auto program = Program::load(*utils::MappedFile::open(image));
+      keep(program.unwrap().actions());
+    });
+    std::filesystem::remove(source);
+    std::filesystem::remove(image);
+  }
+}
+
+// Parses a file of a million transition lines without compiling it.
+inline auto parserLines(Runner &runner) -> void {
+  constexpr auto States = Size{100000};
+  auto source =
+      (std::filesystem::temp_directory_path() / "turing_bench.tm").string();
+  writeMachine(source, States);
+  runner.measure("parser/lines", States * 10, [&source] {
+    auto parser = std::move(Parser::open(source, "").unwrap());
+    keep(parser.parseMachine().value());
+    keep(parser.machine().transitions.size());
+  });
+  std::filesystem::remove(source);
+}
+
+} // namespace turing::bench
@@ -0,0 +1,95 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+
+#include <Bench.h>
+#include <Machines.h>
+#include <Parser.h>
+
+namespace turing::bench {
+
+using machine::Program;
+using parser::Parser;
+using simulator::Options;
+using simulator::Simulator;
+
+// Parses and compiles the source of machine.
+inline auto compileReference(const Reference &machine)
+    -> std::shared_ptr<const Program> {
+  return Parser::fromSource(machine.source).program().unwrap();
+}
+
+// Times parsing and compiling each reference machine, from a file as turing
+// does.
+inline auto suiteParse(Runner &runner) -> void {
+  constexpr auto Repeats = Size{200};
+  auto source =
+      (std::filesystem::temp_directory_path() / "turing_bench.tm").string();
+  for (const auto &machine : referenceMachines()) {
+    {
+      auto fs = std::ofstream(source);
+      fs << machine.source;
+    }
+    runner.measure("suite/parse/" + machine.name, Repeats, [&source] {
+      for (auto i = Size{0}; i < Repeats; i++) {
+        auto parser = std::move(Parser::open(source, "").unwrap());
+        keep(parser.program().unwrap()->actions());
+      }
+    });
+  }
+  std::filesystem::remove(source);
+}
+
+// Runs each reference machine on the table engine, again and again until
+// enough steps are taken to time, and reports the time per step and the
+// memory its tapes ended up holding.
+inline auto suiteSteps(Runner &runner) -> void {
+  constexpr auto MinSteps = Size{10000000};
+  for (const auto &machine : referenceMachines()) {
+    auto simulator =
+        Simulator::of(compileReference(machine), machine.input).unwrap();
+    simulator.execute();
+    auto steps = simulator.steps();
+    runner.memory("suite/memory/" + machine.name, simulator.footprint());
+
+    auto runs = std::max<Size>(1, MinSteps / std::max<Size>(steps, 1));
+    runner.measure("suite/steps/" + machine.name, runs * steps,
+                   [&simulator, &machine, runs] {
+                     for (auto i = Size{0}; i < runs; i++) {
+                       simulator.reset(machine.input);
+                       simulator.execute();
+                     }
+                     keep(simulator.steps());
+                   });
+  }
+}
+
+// Runs machines that write a cell per step into fresh blanks on either side,
+// next to one writing the same two cells over and over, for as many steps.
+// The difference in time per step is what growing the tape costs.
+inline auto suiteGrowth(Runner &runner) -> void {
+  constexpr auto Steps = Size{20000000};
+  auto bounded =
+      "q0 _ 1 r q1\nq0 1 1 r q1\nq1 _ 1 l q0\nq1 1 1 l q0\n";
+  for (auto [name, transitions] :
+       {std::pair{"bounded", bounded}, std::pair{"right", "q0 _ 1 r q0\n"},
+        std::pair{"left", "q0 _ 1 l q0\n"}}) {
+    auto machine =
+        Reference{std::string{name},
+                  sourceHeader("q0,q1,halt", "1", "1,_", "q0", "halt", 1) +
+                      transitions,
+                  ""};
+    auto options = Options{};
+    options.maxSteps = Steps;
+    auto simulator =
+        Simulator::of(compileReference(machine), "", options).unwrap();
+    runner.measure("suite/growth/" + machine.name, Steps, [&simulator] {
+      simulator.execute();
+      keep(simulator.steps());
+    });
+    runner.memory("suite/memory/growth-" + machine.name,
+                  simulator.footprint());
+  }
+}
+
+} // namespace turing::bench
@@ -0,0 +1,63 @@
+#pragma once
+#include <Bench.h>
+#include <Tape.h>
+
+namespace turing::bench {
+
+using machine::Move;
+using machine::Tape;
+
+// Writes one symbol per cell while sweeping in one direction. Both directions
+// should cost the same per cell, whatever the number of cells.
+inline auto tapeSweep(Runner &runner) -> void {
+  for (auto cells : {Size{100000}, Size{1000000}, Size{10000000}}) {
+    for (auto move : {Move::Left, Move::Right}) {
+      auto name = move == Move::Left ? "tape/left-sweep" : "tape/right-sweep";
+      runner.measure(name, cells, [cells, move] {
+        auto tape = Tape(0, 1, '_');
+        for (auto i = Size{0}; i < cells; i++) {
+          tape.write('1', move);
+        }
+        keep(tape.head());
+      });
+    }
+  }
+}
+
+// Writes back and forth over a span of cells with the hash tracked, next to
+// the same writes without it, so the cost of keeping the hash shows per step.
+inline auto tapeHash(Runner &runner) -> void {
+  constexpr auto Steps = Size{10000000};
+  constexpr auto Span = Size{1000};
+  for (auto tracked : {false, true}) {
+    auto name = tracked ? "tape/hashed-writes" : "tape/writes";
+    runner.measure(name, Steps, [tracked] {
+      auto tape = Tape(0, 1, '_');
+      if (tracked) {
+        tape.trackHash();
+      }
+      for (auto i = Size{0}; i < Steps; i++) {
+        tape.write(i & 1 ? '1' : '0', (i / Span) & 1 ? Move::Left : Move::Right);
+      }
+      keep(tape.hash());
+    });
+  }
+}
+
+// Writes islands of symbols far apart with blanks in between, which makes a
+// contiguous tape switch to pages once its span gets large.
+inline auto tapeIslands(Runner &runner) -> void {
+  constexpr auto Gap = Size{1} << 25;
+  runner.measure("tape/islands", Gap * 2, [] {
+    auto tape = Tape(0, 1, '_');
+    for (auto island = 0; island < 2; island++) {
+      tape.write('1', Move::Right);
+      for (auto i = Size{1}; i < Gap; i++) {
+        tape.write('_', Move::Right);
+      }
+    }
+    keep(tape.mode() == Tape::Storage::Paged);
+  });
+}
+
+} // namespace turing::bench
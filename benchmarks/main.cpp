@@ -0,0 +1,57 @@
+#include <fstream>
+
+#include <Bench.h>
+#include <EngineBench.h>
+#include <ProgramBench.h>
+#include <SuiteBench.h>
+#include <TapeBench.h>
+
+using turing::bench::Benchmark;
+using turing::bench::Runner;
+
+auto main(int argc, char **argv) -> int {
+  const auto benchmarks = std::vector<Benchmark>{
+      {"tape/sweep", turing::bench::tapeSweep},
+      {"tape/islands", turing::bench::tapeIslands},
+      {"tape/hash", turing::bench::tapeHash},
+      {"program/image", turing::bench::programImage},
+      {"parser/lines", turing::bench::parserLines},
+      {"engine/steps", turing::bench::engineSteps},
+      {"engine/tapes", turing::bench::engineTapes},
+      {"suite/parse", turing::bench::suiteParse},
+      {"suite/steps", turing::bench::suiteSteps},
+      {"suite/growth", turing::bench::suiteGrowth},
+  };
+
+  // with arguments, only benchmarks whose name starts with one of them run,
+  // and --json <file> writes the results there as well
+  auto filters = std::vector<std::string_view>{};
+  auto json = std::string{};
+  for (auto i = 1; i < argc; i++) {
+    if (std::string_view{argv[i]} == "--json" && i + 1 < argc) {
+      json = argv[++i];
+    } else {
+      filters.emplace_back(argv[i]);
+    }
+  }
+  auto runner = Runner{};
+  for (const auto &benchmark : benchmarks) {
+    if (filters.empty() ||
+        std::any_of(filters.begin(), filters.end(), [&](auto filter) {
+          return benchmark.name.starts_with(filter);
+        })) {
+      benchmark.run(runner);
+    }
+  }
+
+  if (!json.empty()) {
+    auto fs = std::ofstream(json);
+    fs << runner.json();
+    if (!fs.flush()) {
+      turing::utils::Logger::instance().error("failed to write file: {}",
+                                              json);
+      return 1;
+    }
+  }
+  return 0;
+}
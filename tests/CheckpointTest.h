@@ -0,0 +1,135 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+
+#include <SweepTest.h>
+#include <Test.h>
+
+namespace turing::test {
+
+// A file in the temporary directory, removed when it goes out of scope.
+struct TempFile {
+  std::string path;
+
+  explicit TempFile(std::string_view name)
+      : path((std::filesystem::temp_directory_path() / name).string()) {}
+  TempFile(const TempFile &) = delete;
+  auto operator=(const TempFile &) -> TempFile & = delete;
+  ~TempFile() { std::filesystem::remove(path); }
+
+  auto read() const -> std::string {
+    auto fs = std::ifstream(path, std::ios::binary);
+    auto text = std::ostringstream{};
+    text << fs.rdbuf();
+    return text.str();
+  }
+
+  auto write(std::string_view bytes) const -> void {
+    auto fs = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    fs.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  }
+};
+
+// How a run ended: how execute() returned, the state, the step count and
+// every tape with its storage, head and hash, without listing every index.
+inline auto summary(std::string_view source, std::string_view input,
+                    Options options) -> std::string {
+  auto simulator = Parser::fromSource(source, input, options).parse();
+  if (!simulator) {
+    return simulator.error().message();
+  }
+  auto &run = *simulator;
+  auto end = run.execute();
+  auto text = utils::format("{} {} {}", end.error().message(), run.state(),
+                            run.steps());
+  for (const auto &tape : run.tapes()) {
+    text += "\n" + contents(tape);
+  }
+  return text;
+}
+
+// Runs source up to stop steps saving a checkpoint, resumes it with the
+// limit of options, and tells whether that ends as one run with options.
+inline auto resumesAsOneRun(std::string_view source, std::string_view input,
+                            Steps stop, Options options) -> bool {
+  auto file = TempFile("turing_test.checkpoint");
+  auto first = options;
+  first.maxSteps = stop;
+  first.checkpoint = file.path;
+  auto interrupted = summary(source, input, first);
+  auto resumed = options;
+  resumed.resume = file.path;
+  return interrupted.starts_with("limit exceeded") &&
+         summary(source, "", resumed) == summary(source, input, options);
+}
+
+// A run stopped by --max-steps and resumed from its checkpoint ends as a
+// run that was never stopped, on flat and on paged tapes.
+inline auto checkpointResume(Checker &checker) -> void {
+  auto machines = std::vector<std::pair<std::string, std::string>>{
+      {"zigzag", std::string{Zigzag}},
+      {"case1", sample("case1.tm")},
+      {"case2", sample("case2.tm")},
+      {"three tapes", std::string{ThreeTapes}},
+  };
+  for (const auto &[name, source] : machines) {
+    for (auto stop : {1, 9, 20}) {
+      auto options = Options{};
+      checker.check(resumesAsOneRun(source, "1111111111111", stop, options),
+                    utils::format("{} resumed after {} steps", name, stop));
+      options.maxSteps = stop + 5;
+      checker.check(resumesAsOneRun(source, "1111111111111", stop, options),
+                    utils::format("{} resumed after {} steps up to a "
+                                  "limit",
+                                  name, stop));
+    }
+  }
+
+  // fills blanks past the span at which a tape switches to pages; sweeping
+  // keeps that fast
+  constexpr auto Filler = std::string_view{
+      "#Q = {q}\n#S = {1}\n#G = {1, _}\n#q0 = q\n#B = _\n#F = {}\n#N = 1\n"
+      "q _ 1 r q\n"};
+  auto options = Options{};
+  options.sweep = true;
+  options.maxSteps = Tape::PagedSpanThreshold + 5000;
+  checker.check(resumesAsOneRun(Filler, "", Tape::PagedSpanThreshold + 1000,
+                                options),
+                "a paged tape resumed");
+}
+
+// Checkpoints of another machine, and files cut short or not checkpoints at
+// all, are refused.
+inline auto checkpointRefused(Checker &checker) -> void {
+  auto file = TempFile("turing_test.checkpoint");
+  auto options = Options{};
+  options.maxSteps = 20;
+  options.checkpoint = file.path;
+  static_cast<void>(summary(Zigzag, "1111111", options));
+  auto saved = file.read();
+
+  auto resume = [&file](std::string_view source) {
+    auto options = Options{};
+    options.resume = file.path;
+    return Parser::fromSource(source, "", options).parse();
+  };
+  checker.check(resume(Zigzag).isOk(), "the checkpoint resumes");
+  checker.check(resume(BusyBeaver4).error() ==
+                    TuringError::CheckpointMismatch,
+                "a checkpoint of another machine is refused");
+  for (auto size : {Size{0}, Size{7}, Size{40}, saved.size() / 2,
+                    saved.size() - 1}) {
+    file.write(std::string_view{saved}.substr(0, size));
+    checker.check(resume(Zigzag).error() == TuringError::CheckpointInvalid,
+                  utils::format("a checkpoint cut to {} of {} bytes is "
+                                "invalid",
+                                size, saved.size()));
+  }
+  auto garbled = saved;
+  garbled[0] = 'X';
+  file.write(garbled);
+  checker.check(resume(Zigzag).error() == TuringError::CheckpointInvalid,
+                "a file without the magic is invalid");
+}
+
+} // namespace turing::test
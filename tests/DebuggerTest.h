@@ -0,0 +1,63 @@
+#pragma once
+#include <Debugger.h>
+#include <EngineTest.h>
+
+namespace turing::test {
+
+using simulator::Debugger;
+
+// A machine that never halts: it lays 1s at both ends of a block in turn, so
+// a run of millions of steps stays a few thousand cells wide.
+constexpr auto Widening = std::string_view{
+    "#Q = {q, b, f}\n#S = {1}\n#G = {1, _}\n#q0 = q\n#B = _\n#F = {}\n"
+    "#N = 1\n"
+    "q _ 1 l b\nb 1 1 l b\nb _ 1 r f\nf 1 1 r f\nf _ 1 l b\n"};
+
+// The state, step count and tapes a debugger shows.
+inline auto shown(const Debugger &debugger) -> std::string {
+  return utils::format("{} {}\n{}", debugger.state(), debugger.steps(),
+                       debugger.tapes().toString());
+}
+
+// The same after stepping a fresh simulator of source steps times.
+inline auto stepped(std::string_view source, std::string_view input,
+                    Steps steps) -> std::string {
+  auto simulator = Parser::fromSource(source, input).parse().unwrap();
+  simulator.step(steps);
+  return utils::format("{} {}\n{}", simulator.state(), simulator.steps(),
+                       simulator.tapes().toString());
+}
+
+// A debugger moved to a step, back or forward, inside the undo log, before
+// it, and past the snapshots dropped as they thin out, shows what stepping
+// forward from scratch reaches.
+inline auto debuggerGoTo(Checker &checker) -> void {
+  auto program = Parser::fromSource(Widening).program().unwrap();
+  auto debugger = Debugger(program, "", {});
+  auto far = Debugger::FirstSnapshotEvery * (Debugger::SnapshotLimit + 1) + 7;
+  debugger.goTo(far);
+  checker.check(shown(debugger) == stepped(Widening, "", far),
+                "goto past the snapshot limit steps as the simulator");
+  for (auto target : {far - 1, far - 1000, far - Debugger::LogLimit / 2 - 3,
+                      far - Debugger::LogLimit - 3,
+                      Debugger::FirstSnapshotEvery * 3 + 5, Steps{2},
+                      Debugger::LogLimit + 11, far + 100}) {
+    debugger.goTo(target);
+    checker.check(shown(debugger) == stepped(Widening, "", target),
+                  utils::format("goto {} from step {} shows the run at {}",
+                                target, far, target));
+  }
+
+  auto case1 = Parser::fromSource(sample("case1.tm"), "1001");
+  auto halting = Debugger(case1.program().unwrap(), "1001", {});
+  halting.goTo(1000);
+  auto end = halting.steps();
+  checker.check(end < 1000, "goto stops where the machine halts");
+  checker.check(shown(halting) == stepped(sample("case1.tm"), "1001", 1000),
+                "a halted debugger shows the end of the run");
+  halting.goTo(end / 2);
+  checker.check(shown(halting) == stepped(sample("case1.tm"), "1001", end / 2),
+                "goto back from the end shows the run halfway");
+}
+
+} // namespace turing::test
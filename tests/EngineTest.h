@@ -0,0 +1,186 @@
+#pragma once
+#include <fstream>
+#include <sstream>
+
+#include <SimulatorTest.h>
+#include <Test.h>
+
+namespace turing::test {
+
+using simulator::Engine;
+using simulator::Options;
+using machine::Size;
+
+// Busy beaver champions on a blank tape, with 3 and 4 states. They halt
+// after 14 and 107 steps.
+constexpr auto BusyBeaver3 = std::string_view{
+    "#Q = {A, B, C, H}\n#S = {1}\n#G = {1, _}\n#q0 = A\n#B = _\n#F = {H}\n"
+    "#N = 1\n"
+    "A _ 1 r B\nA 1 1 r H\nB _ 1 l B\nB 1 _ r C\nC _ 1 l C\nC 1 1 l A\n"};
+constexpr auto BusyBeaver4 = std::string_view{
+    "#Q = {A, B, C, D, H}\n#S = {1}\n#G = {1, _}\n#q0 = A\n#B = _\n#F = {H}\n"
+    "#N = 1\n"
+    "A _ 1 r B\nA 1 1 l B\nB _ 1 l A\nB 1 _ l C\nC _ 1 r H\nC 1 1 l D\n"
+    "D _ 1 r D\nD 1 _ r A\n"};
+
+// Marks the 1s of its input one at a time, walking to the far end of the
+// tape and back after each: long runs of equal blocks in both directions.
+constexpr auto Zigzag = std::string_view{
+    "#Q = {q0, r, b, halt}\n#S = {1}\n#G = {1, x, _}\n#q0 = q0\n#B = _\n"
+    "#F = {halt}\n#N = 1\n"
+    "q0 x x r q0\nq0 1 x r r\nq0 _ _ * halt\n"
+    "r * * r r\nr _ _ l b\nb * * l b\nb _ _ r q0\n"};
+
+// The text of the sample program name in programs/.
+inline auto sample(std::string_view name) -> std::string {
+  auto fs = std::ifstream(std::string{TURING_PROGRAMS_DIR "/"} +
+                          std::string{name});
+  auto text = std::ostringstream{};
+  text << fs.rdbuf();
+  return text.str();
+}
+
+// How execute() ended, followed by the snapshot of the simulator, or the
+// error that kept source from running with options.
+inline auto outcome(std::string_view source, std::string_view input,
+                    Options options = {}) -> std::string {
+  auto simulator = Parser::fromSource(source, input, options).parse();
+  if (!simulator) {
+    return simulator.error().message();
+  }
+  auto &run = *simulator;
+  auto end = run.execute();
+  return utils::format("{}\n{}", end.error().message(), snapshot(run));
+}
+
+inline auto withEngine(Engine engine, Options options = {}) -> Options {
+  options.engine = engine;
+  return options;
+}
+
+// Swaps two cells forever without leaving them, so with blocks of two or
+// more cells every step is taken inside one block.
+constexpr auto Oscillator = std::string_view{
+    "#Q = {q, p, h}\n#S = {a, b}\n#G = {a, b, _}\n#q0 = q\n#B = _\n"
+    "#F = {h}\n#N = 1\n"
+    "q a a r p\np b b l q\n"};
+
+// The macro engine ends every run where the table engine does, with the
+// same step count, whether it crosses runs of equal blocks or not.
+inline auto engineMacro(Checker &checker) -> void {
+  auto macro = withEngine(Engine::Macro);
+  checker.check(outcome(BusyBeaver3, "", macro) == outcome(BusyBeaver3, ""),
+                "the 3-state busy beaver ends as on the table engine");
+  checker.check(outcome(BusyBeaver4, "", macro) == outcome(BusyBeaver4, ""),
+                "the 4-state busy beaver ends as on the table engine");
+  for (auto ones : {0, 1, 2, 3, 64, 300}) {
+    auto input = std::string(ones, '1');
+    for (auto blockSize : {0, 1, 2, 3, 8}) {
+      macro.blockSize = blockSize;
+      checker.check(outcome(Zigzag, input, macro) == outcome(Zigzag, input),
+                    utils::format("zigzag on {} ones ends as on the table "
+                                  "engine with blocks of {}",
+                                  ones, blockSize));
+    }
+  }
+  auto case2 = std::move(
+      Parser::open(TURING_PROGRAMS_DIR "/case2.tm", "11", macro).unwrap());
+  checker.check(case2.parse().error() ==
+                    TuringError::SimulatorUnsupportedMachine,
+                "the macro engine rejects machines of two tapes");
+}
+
+// A step limit reached inside a block stops the macro engine on the very
+// step the table engine stops on. Between blocks it is checked every few
+// macro steps, so the run stops at or past the limit.
+inline auto engineMacroLimit(Checker &checker) -> void {
+  for (auto limit : {1, 2, 3, 1000, 100001}) {
+    auto table = Options{};
+    table.maxSteps = limit;
+    for (auto blockSize : {0, 2, 4}) {
+      auto macro = withEngine(Engine::Macro, table);
+      macro.blockSize = blockSize;
+      checker.check(outcome(Oscillator, "ab", macro) ==
+                        outcome(Oscillator, "ab", table),
+                    utils::format("a limit of {} inside blocks of {} stops "
+                                  "where the table engine does",
+                                  limit, blockSize));
+    }
+  }
+  for (auto limit : {50, 99, 106}) {
+    auto macro = withEngine(Engine::Macro);
+    macro.maxSteps = limit;
+    auto simulator =
+        Parser::fromSource(BusyBeaver4, "", macro).parse().unwrap();
+    checker.check(simulator.execute().error() ==
+                          TuringError::SimulatorLimitExceeded &&
+                      simulator.steps() >= Steps(limit),
+                  utils::format("a limit of {} between blocks stops the "
+                                "busy beaver at or past it",
+                                limit));
+  }
+}
+
+// Copies its input onto the second and third tape with wildcards, walks all
+// heads back and erases the first tape where the copies agree with it.
+constexpr auto ThreeTapes = std::string_view{
+    "#Q = {cp, back, cmp, halt}\n#S = {0, 1}\n#G = {0, 1, _}\n#q0 = cp\n"
+    "#B = _\n#F = {halt}\n#N = 3\n"
+    "cp 0__ 000 rrr cp\ncp 1__ 111 rrr cp\ncp ___ ___ lll back\n"
+    "back *** *** lll back\nback ___ ___ rrr cmp\n"
+    "cmp 00* _0* rr* cmp\ncmp 11* _1* rr* cmp\ncmp __* __* *** halt\n"};
+
+// Copies the input from the first tape onto every other one of tapes tapes
+// and walks all heads back.
+inline auto wideCopy(Size tapes) -> std::string {
+  auto source = utils::format("#Q = {cp, back, halt}\n#S = {0, 1}\n"
+                              "#G = {0, 1, _}\n#q0 = cp\n#B = _\n"
+                              "#F = {halt}\n#N = {}\n",
+                              tapes);
+  auto blanks = std::string(tapes, '_');
+  for (auto bit : {'0', '1'}) {
+    auto all = std::string(tapes, bit);
+    source += utils::format("cp {}{} {} {} cp\n", bit,
+                            std::string(tapes - 1, '_'), all,
+                            std::string(tapes, 'r'));
+    source += utils::format("back {} {} {} back\n", all, all,
+                            std::string(tapes, 'l'));
+  }
+  source += utils::format("cp {} {} {} back\n", blanks, blanks,
+                          std::string(tapes, 'l'));
+  source += utils::format("back {} {} {} halt\n", blanks, blanks,
+                          std::string(tapes, 'r'));
+  return source;
+}
+
+// The threaded engine ends every run where the table engine does, for one,
+// two and three tapes, which have loops of their own, and for more.
+inline auto engineThreaded(Checker &checker) -> void {
+  auto machines = std::vector<std::pair<std::string, std::string>>{
+      {"zigzag", std::string{Zigzag}},
+      {"the 4-state busy beaver", std::string{BusyBeaver4}},
+      {"case1", sample("case1.tm")},
+      {"case2", sample("case2.tm")},
+      {"three tapes", std::string{ThreeTapes}},
+      {"four tapes", wideCopy(4)},
+      {"seven tapes", wideCopy(7)},
+  };
+  auto inputs = std::vector<std::string>{"", "1", "0110", "111111111",
+                                         "1111111111111111", "10110011101"};
+  for (const auto &[name, source] : machines) {
+    for (const auto &input : inputs) {
+      for (auto limit : {0, 1, 5, 40}) {
+        auto table = Options{};
+        table.maxSteps = limit;
+        auto threaded = withEngine(Engine::Threaded, table);
+        checker.check(outcome(source, input, threaded) ==
+                          outcome(source, input, table),
+                      utils::format("{} on '{}' with a limit of {} ends as "
+                                    "on the table engine",
+                                    name, input, limit));
+      }
+    }
+  }
+}
+
+} // namespace turing::test
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstring>
+#include <sstream>
+
+#include <EngineTest.h>
+
+namespace turing::test {
+
+using machine::Program;
+
+// The image --compile writes for source.
+inline auto compiled(std::string_view source) -> std::string {
+  auto program = Parser::fromSource(source).program().unwrap();
+  auto os = std::ostringstream{};
+  static_cast<void>(program->save(os));
+  return os.str();
+}
+
+inline auto fromImage(std::string_view image, std::string_view input = {})
+    -> Parser {
+  return Parser::fromImage(std::as_bytes(std::span{image}), input);
+}
+
+// Overwrites the field of the image header at offset with value.
+inline auto patched(std::string image, Size offset, std::uint64_t value,
+                    Size size = sizeof(std::uint64_t)) -> std::string {
+  std::memcpy(image.data() + offset, &value, size);
+  return image;
+}
+
+// An image runs as its source does, and one cut short, grown, or with a
+// header that does not fit it is refused as invalid.
+inline auto imageRefused(Checker &checker) -> void {
+  for (const auto &[name, input] :
+       {std::pair{"case1.tm", "1001"}, std::pair{"case2.tm", "1111"}}) {
+    auto source = sample(name);
+    auto image = compiled(source);
+    auto loaded = fromImage(image, input).parse();
+    auto parsed = Parser::fromSource(source, input).parse();
+    checker.check(loaded.isOk(), utils::format("the image of {} loads", name));
+    if (!loaded || !parsed) {
+      continue;
+    }
+    auto &run = *loaded;
+    auto &expected = *parsed;
+    static_cast<void>(run.execute());
+    static_cast<void>(expected.execute());
+    checker.check(snapshot(run) == snapshot(expected),
+                  utils::format("the image of {} runs as its source", name));
+
+    auto invalid = [&](const std::string &damaged, std::string_view what) {
+      checker.check(fromImage(damaged).program().error() ==
+                        TuringError::ImageInvalid,
+                    utils::format("the image of {} is refused {}", name, what));
+    };
+    for (auto cut = Size{0}; cut < image.size(); cut++) {
+      invalid(image.substr(0, cut), utils::format("cut at byte {}", cut));
+    }
+    invalid(image + '\0', "with a byte appended");
+    // the header: magic[8] version:4 byteOrder:4 imageSize:8 tapeCount:8
+    // states:8 actions:8 symbols:8 symbolBits:8 layout:4 initial:4
+    // starSymbols:4 blank:4, then an offset and a size per section
+    invalid(patched(image, 0, 'X', 1), "with a damaged magic number");
+    invalid(patched(image, 8, 2, 4), "of another version");
+    invalid(patched(image, 12, 0x04030201, 4), "of another byte order");
+    invalid(patched(image, 16, image.size() + 8), "with a wrong size");
+    invalid(patched(image, 32, 0), "without states");
+    invalid(patched(image, 64, 3, 4), "of an unknown layout");
+    invalid(patched(image, 68, 1000, 4), "starting in no state");
+    invalid(patched(image, 80, 4), "with a misaligned section");
+    // the state names, whose size is not fixed by the header
+    invalid(patched(image, 104, image.size()), "with a section too large");
+  }
+}
+
+} // namespace turing::test
@@ -0,0 +1,112 @@
+#pragma once
+#include <map>
+
+#include <EngineTest.h>
+
+namespace turing::test {
+
+using machine::Program;
+
+// The inputs of the transitions of q, in declaration order, for a machine
+// of the given tapes. They overlap on the first two tapes, the others read
+// 'a' except for a wildcard on the last one.
+inline auto overlapping(Size tapes) -> std::vector<std::string> {
+  auto rest = std::string(tapes - 3, 'a');
+  auto inputs = std::vector<std::string>{};
+  for (auto head : {"ab", "*b", "bb", "a*", "ab", "_*", "**", "*_", "__"}) {
+    inputs.push_back(head + rest + 'a');
+  }
+  inputs.push_back("**" + rest + '*');
+  inputs.push_back("c*" + rest + '*');
+  return inputs;
+}
+
+// The source of a machine whose state q fires the transitions of inputs.
+inline auto overlappingSource(const std::vector<std::string> &inputs)
+    -> std::string {
+  auto tapes = inputs.front().size();
+  auto source = utils::format("#Q = {q, h}\n#S = {a}\n#G = {a, b, c, _}\n"
+                              "#q0 = q\n#B = _\n#F = {h}\n#N = {}\n",
+                              tapes);
+  for (const auto &input : inputs) {
+    source += utils::format("q {} {} {} h\n", input, std::string(tapes, 'c'),
+                            std::string(tapes, '*'));
+  }
+  return source;
+}
+
+// Input with every wildcard replaced by each of symbols in turn.
+inline auto instances(const std::string &input, std::string_view symbols)
+    -> std::vector<std::string> {
+  auto keys = std::vector<std::string>{input};
+  for (auto i = Size{0}; i < input.size(); i++) {
+    if (input[i] != '*') {
+      continue;
+    }
+    auto next = std::vector<std::string>{};
+    for (const auto &key : keys) {
+      for (auto symbol : symbols) {
+        next.push_back(key);
+        next.back()[i] = symbol;
+      }
+    }
+    keys = std::move(next);
+  }
+  return keys;
+}
+
+// What the parser kept before wildcards became patterns: every wildcard
+// expanded into each non-blank tape symbol, and the first transition to
+// claim a key keeping it.
+inline auto expanded(const std::vector<std::string> &inputs)
+    -> std::map<std::string, Size> {
+  auto table = std::map<std::string, Size>{};
+  for (auto action = Size{0}; action < inputs.size(); action++) {
+    for (const auto &key : instances(inputs[action], "abc")) {
+      table.try_emplace(key, action);
+    }
+  }
+  return table;
+}
+
+// Every layout resolves overlapping wildcard transitions as the eagerly
+// expanded table did: the first declared transition matching the symbols
+// under the heads fires, whether it is a pattern or not.
+inline auto programWildcards(Checker &checker) -> void {
+  for (const auto &[tapes, layout] :
+       {std::pair{Size{3}, Program::Layout::Dense},
+        std::pair{Size{12}, Program::Layout::Sparse},
+        std::pair{Size{33}, Program::Layout::Wide}}) {
+    auto inputs = overlapping(tapes);
+    auto program =
+        Parser::fromSource(overlappingSource(inputs)).program().unwrap();
+    checker.check(program->tableLayout() == layout,
+                  utils::format("{} tapes take the expected layout", tapes));
+    auto q = machine::StateId{0};
+    while (program->stateName(q) != "q") {
+      q++;
+    }
+
+    // every symbol, blank included, under every wildcard of every input
+    auto table = expanded(inputs);
+    auto probes = std::vector<std::string>{};
+    for (const auto &input : inputs) {
+      auto keys = instances(input, "abc_");
+      probes.insert(probes.end(), keys.begin(), keys.end());
+    }
+    probes.push_back(std::string(tapes, '_'));
+    probes.push_back(std::string(tapes, 'b'));
+    for (const auto &probe : probes) {
+      auto it = table.find(probe);
+      auto expected = it == table.end() ? Program::NoAction
+                                        : static_cast<machine::ActionId>(
+                                              it->second);
+      checker.check(program->find(q, probe) == expected,
+                    utils::format("{} tapes under {} fire the transition "
+                                  "declared first",
+                                  tapes, probe));
+    }
+  }
+}
+
+} // namespace turing::test
@@ -0,0 +1,92 @@
+#pragma once
+#include <Parser.h>
+#include <Test.h>
+
+namespace turing::test {
+
+using machine::Steps;
+using parser::Parser;
+using simulator::Simulator;
+using utils::TuringError;
+
+constexpr auto Case1 = TURING_PROGRAMS_DIR "/case1.tm";
+
+// A fresh simulator of the sample machine programs/case1.tm on input.
+inline auto case1(std::string_view input) -> Simulator {
+  auto parser = std::move(Parser::open(Case1, input).unwrap());
+  return parser.parse().unwrap();
+}
+
+// Everything a run leaves behind: the state, the step count and the tapes
+// with their heads.
+inline auto snapshot(const Simulator &simulator) -> std::string {
+  return utils::format("{} {} {}\n{}", simulator.state(), simulator.steps(),
+                       simulator.accepted() ? "accepted" : "rejected",
+                       simulator.tapes().toString());
+}
+
+// Runs the machine to the end with execute().
+inline auto executed(std::string_view input) -> std::string {
+  auto simulator = case1(input);
+  static_cast<void>(simulator.execute());
+  return snapshot(simulator);
+}
+
+// Stepping one step at a time and a few at a time ends where execute() does.
+inline auto simulatorStep(Checker &checker) -> void {
+  auto expected = executed("1001");
+  auto single = case1("1001");
+  while (single.step() == 1) {
+  }
+  checker.check(snapshot(single) == expected, "single steps end as execute()");
+  checker.check(single.halted(), "the machine halts");
+  checker.check(single.step() == 0, "a halted machine takes no step");
+
+  auto chunked = case1("1001");
+  checker.check(chunked.step(3) == 3, "step(3) takes three steps");
+  checker.check(chunked.steps() == 3, "steps() counts them");
+  chunked.step(1000);
+  checker.check(snapshot(chunked) == expected, "chunks end as execute()");
+}
+
+// runUntil() stops where its predicate first holds, or at the end.
+inline auto simulatorRunUntil(Checker &checker) -> void {
+  auto stepped = case1("1001");
+  stepped.step(5);
+  auto until = case1("1001");
+  checker.check(
+      until.runUntil([](const Simulator &s) { return s.steps() == 5; }),
+      "runUntil() reaches step 5");
+  checker.check(snapshot(until) == snapshot(stepped),
+                "runUntil() stops where step(5) does");
+
+  checker.check(until.runUntil([](const Simulator &s) { return s.halted(); }),
+                "runUntil() reaches the end");
+  checker.check(snapshot(until) == executed("1001"),
+                "runUntil() ends as execute()");
+}
+
+// A reset simulator runs as a fresh one on the new input.
+inline auto simulatorReset(Checker &checker) -> void {
+  auto simulator = case1("1001");
+  static_cast<void>(simulator.execute());
+  checker.check(simulator.reset("0110").isOk(), "reset() takes a new input");
+  checker.check(snapshot(simulator) == snapshot(case1("0110")),
+                "reset() starts over");
+  checker.check(simulator.execute().isOk(), "the machine accepts again");
+  checker.check(snapshot(simulator) == executed("0110"),
+                "a reset run ends as a fresh one");
+  checker.check(simulator.reset("012").error() ==
+                    TuringError::SimulatorIllegalInput,
+                "reset() rejects symbols outside the input alphabet");
+}
+
+// A file that cannot be read is an error returned to the caller.
+inline auto parserUnreadable(Checker &checker) -> void {
+  auto parser = Parser::open(TURING_PROGRAMS_DIR "/missing.tm", "");
+  checker.check(parser.isErr() &&
+                    parser.error() == TuringError::FileUnreadable,
+                "open() returns FileUnreadable");
+}
+
+} // namespace turing::test
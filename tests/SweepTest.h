@@ -0,0 +1,153 @@
+#pragma once
+#include <EngineTest.h>
+#include <Tape.h>
+#include <Test.h>
+
+namespace turing::test {
+
+using machine::Move;
+using machine::Position;
+using machine::Symbol;
+using machine::Tape;
+
+// The length of the run runLength should find, counted cell by cell.
+inline auto countRun(const Tape &tape, Move move, Symbol symbol, Size limit)
+    -> Size {
+  auto count = Size{0};
+  for (auto pos = tape.head(); count < limit && tape.at(pos) == symbol;
+       pos += static_cast<Position>(move)) {
+    count++;
+  }
+  return count;
+}
+
+// What a tape holds: its storage, head, non-blank cells and hash.
+inline auto contents(const Tape &tape) -> std::string {
+  return utils::format("{} {} {} {} {}",
+                       tape.mode() == Tape::Storage::Paged ? "paged" : "flat",
+                       tape.head(), tape.firstSymbol().value_or(0),
+                       tape.hash(), tape.result());
+}
+
+// runLength compares a machine word at a time; runs that end on either side
+// of every word boundary, from heads at every alignment, in both directions,
+// and runs of blanks past the stored cells all count as cell by cell.
+inline auto sweepRunLength(Checker &checker) -> void {
+  for (auto head = 0; head < 9; head++) {
+    for (auto length = 0; length < 20; length++) {
+      for (auto move : {Move::Left, Move::Right}) {
+        auto cells = std::string(40, '1');
+        auto end = move == Move::Right ? 10 + head + length
+                                       : 29 - head - length;
+        cells[end] = 'x';
+        auto tape = Tape(0, 1, '_');
+        auto at = move == Move::Right ? 10 + head : 29 - head;
+        tape.load(cells, 0, at);
+        for (auto limit : {Size{3}, Size{1000}}) {
+          checker.check(tape.runLength(move, '1', limit) ==
+                            countRun(tape, move, '1', limit),
+                        utils::format("a run of {} ones from offset {} "
+                                      "with a limit of {}",
+                                      length, head, limit));
+        }
+      }
+    }
+  }
+  auto tape = Tape(0, 1, '_');
+  tape.load("__1__", -2, 0);
+  for (auto move : {Move::Left, Move::Right}) {
+    checker.check(tape.runLength(move, '_', 1000) ==
+                      countRun(tape, move, '_', 1000),
+                  "a run of blanks past the stored cells");
+  }
+}
+
+// Sweeps a copy of tape and steps another one cell at a time, and tells
+// whether both end the same.
+inline auto sweepsAsWrites(Tape tape, Symbol symbol, Move move, Size count)
+    -> bool {
+  auto stepped = tape;
+  tape.sweep(symbol, move, count);
+  for (auto i = Size{0}; i < count; i++) {
+    stepped.write(symbol, move);
+  }
+  return contents(tape) == contents(stepped);
+}
+
+// sweep ends as count writes do, inside the buffer, growing it on either
+// side, growing it into pages and on pages, with the hash tracked.
+inline auto sweepWrites(Checker &checker) -> void {
+  auto tape = Tape(0, 1, '_');
+  tape.load("1111x1111", -4, 0);
+  tape.trackHash();
+  for (auto symbol : {'y', '_', '*'}) {
+    for (auto move : {Move::Left, Move::Right}) {
+      for (auto count : {Size{1}, Size{3}, Size{4}, Size{40}}) {
+        checker.check(sweepsAsWrites(tape, symbol, move, count),
+                      utils::format("sweeping {} cells with '{}'", count,
+                                    symbol));
+      }
+    }
+  }
+
+  auto wide = std::string(Tape::PagedSpanThreshold - 100, '1');
+  auto edge = Tape(0, 1, '_');
+  edge.load(wide, 0, static_cast<Position>(wide.size()) - 10);
+  edge.trackHash();
+  checker.check(sweepsAsWrites(edge, 'y', Move::Right, 1000),
+                "a sweep growing the tape into pages");
+  auto paged = edge;
+  paged.sweep('y', Move::Right, 1000);
+  checker.check(paged.mode() == Tape::Storage::Paged,
+                "the tape switched to pages");
+  checker.check(sweepsAsWrites(paged, 'z', Move::Left, 5000),
+                "a sweep over pages");
+  checker.check(sweepsAsWrites(paged, '_', Move::Right, 5000),
+                "a sweep of blanks over unallocated pages");
+}
+
+// Whole runs with --sweep end with the tapes, state and step count of runs
+// without it, also when a limit or a budget checkpoint cuts a sweep short.
+inline auto sweepRuns(Checker &checker) -> void {
+  constexpr auto Walker = std::string_view{
+      "#Q = {q, back, halt}\n#S = {1}\n#G = {1, _}\n#q0 = q\n#B = _\n"
+      "#F = {halt}\n#N = 1\n"
+      "q 1 1 r q\nq _ 1 r back\nback 1 1 l back\nback _ _ r halt\n"};
+  constexpr auto Filler = std::string_view{
+      "#Q = {q}\n#S = {1}\n#G = {1, _}\n#q0 = q\n#B = _\n#F = {}\n#N = 1\n"
+      "q _ 1 r q\n"};
+  auto machines = std::vector<std::pair<std::string, std::string>>{
+      {"walker", std::string{Walker}},
+      {"zigzag", std::string{Zigzag}},
+      {"case1", sample("case1.tm")},
+      {"case2", sample("case2.tm")},
+      {"three tapes", std::string{ThreeTapes}},
+  };
+  for (const auto &[name, source] : machines) {
+    for (auto ones : {0, 1, 7, 8, 9, 100, 3000}) {
+      auto input = std::string(ones, '1');
+      for (auto limit : {0, 5, 1000, 65537}) {
+        auto plain = Options{};
+        plain.maxSteps = limit;
+        auto sweep = plain;
+        sweep.sweep = true;
+        checker.check(outcome(source, input, sweep) ==
+                          outcome(source, input, plain),
+                      utils::format("{} on {} ones with a limit of {}", name,
+                                    ones, limit));
+      }
+    }
+  }
+  // sweeps of fresh blanks are cut at every budget checkpoint and at the
+  // limit
+  for (auto limit : {1, 65535, 65536, 65537, 300001}) {
+    auto plain = Options{};
+    plain.maxSteps = limit;
+    auto sweep = plain;
+    sweep.sweep = true;
+    checker.check(outcome(Filler, "", sweep) == outcome(Filler, "", plain),
+                  utils::format("filling blanks up to a limit of {}", limit));
+  }
+}
+
+} // namespace turing::test
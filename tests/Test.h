@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+
+#include <Logger.h>
+
+namespace turing::test {
+
+using utils::Logger;
+
+// Checker collects the checks of the running test that fail, naming each on
+// stderr.
+struct Checker {
+private:
+  std::string_view test;
+  int failures = 0;
+  const Logger &logger;
+
+public:
+  Checker() : logger(Logger::instance()) {}
+
+  auto start(std::string_view name) -> void { test = name; }
+
+  auto check(bool holds, std::string_view what) -> void {
+    if (!holds) {
+      failures++;
+      logger.error("{}: failed: {}", test, what);
+    }
+  }
+
+  auto failed() const -> int { return failures; }
+};
+
+struct Test {
+  std::string_view name;
+  std::function<void(Checker &)> run;
+};
+
+} // namespace turing::test
@@ -0,0 +1,79 @@
+#pragma once
+#include <sstream>
+
+#include <SimulatorTest.h>
+
+namespace turing::test {
+
+using machine::Size;
+using simulator::Trace;
+
+// The bytes of a trace of the sample machine run to the end on input.
+inline auto recorded(std::string_view input) -> std::string {
+  auto simulator = case1(input);
+  auto os = std::ostringstream{};
+  simulator.traceTo(os);
+  static_cast<void>(simulator.execute());
+  return os.str();
+}
+
+inline auto loaded(std::string_view bytes) -> utils::Result<Trace> {
+  return Trace::load(utils::MappedFile::copy(std::as_bytes(std::span{bytes})));
+}
+
+// The tapes a trace leaves when its steps are applied in turn.
+inline auto replayed(const Trace &trace) -> std::string {
+  auto tapes =
+      machine::Tapes(trace.tapes(), trace.blankSymbol(), trace.input());
+  auto cursor = trace.cursor();
+  for (auto step = Steps{0}; step < trace.steps(); step++) {
+    auto action = cursor.next();
+    tapes.write(trace.output(action), trace.move(action));
+  }
+  return tapes.toString();
+}
+
+// A trace cut short in its header or its end record is refused, one cut
+// between steps holds the steps before the cut, and a damaged magic number
+// is refused.
+inline auto traceTruncated(Checker &checker) -> void {
+  auto bytes = recorded("1001");
+  auto whole = loaded(bytes);
+  auto run = case1("1001");
+  static_cast<void>(run.execute());
+  checker.check(whole.isOk(), "a whole trace loads");
+  if (!whole) {
+    return;
+  }
+  const auto &full = *whole;
+  checker.check(full.end() == Trace::End::Accepted, "it ends accepted");
+  checker.check(full.steps() == run.steps() &&
+                    replayed(full) == run.tapes().toString(),
+                "it holds every step of the run");
+
+  // the machine has fewer than 128 actions, so every step takes one byte and
+  // the end record three
+  auto header = bytes.size() - full.steps() - 3;
+  for (auto cut = Size{0}; cut < bytes.size(); cut++) {
+    auto cutShort = loaded(std::string_view{bytes}.substr(0, cut));
+    if (cut < header || cut > header + full.steps()) {
+      checker.check(cutShort.error() == TuringError::TraceInvalid,
+                    utils::format("a trace cut at byte {} is refused", cut));
+      continue;
+    }
+    auto kept = cut - header;
+    auto stepped = case1("1001");
+    stepped.step(kept);
+    checker.check(cutShort.isOk() && (*cutShort).steps() == kept &&
+                      !(*cutShort).end() &&
+                      replayed(*cutShort) == stepped.tapes().toString(),
+                  utils::format("a trace cut after step {} replays it", kept));
+  }
+
+  auto damaged = bytes;
+  damaged[0] = 'X';
+  checker.check(loaded(damaged).error() == TuringError::TraceInvalid,
+                "a trace with a damaged magic number is refused");
+}
+
+} // namespace turing::test
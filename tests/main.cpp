@@ -0,0 +1,42 @@
+#include <vector>
+
+#include <CheckpointTest.h>
+#include <DebuggerTest.h>
+#include <EngineTest.h>
+#include <ImageTest.h>
+#include <ProgramTest.h>
+#include <SimulatorTest.h>
+#include <SweepTest.h>
+#include <TraceTest.h>
+#include <Test.h>
+
+using turing::test::Checker;
+using turing::test::Test;
+
+auto main() -> int {
+  const auto tests = std::vector<Test>{
+      {"simulator/step", turing::test::simulatorStep},
+      {"simulator/runUntil", turing::test::simulatorRunUntil},
+      {"simulator/reset", turing::test::simulatorReset},
+      {"parser/unreadable", turing::test::parserUnreadable},
+      {"program/wildcards", turing::test::programWildcards},
+      {"engine/macro", turing::test::engineMacro},
+      {"engine/macro-limit", turing::test::engineMacroLimit},
+      {"engine/threaded", turing::test::engineThreaded},
+      {"sweep/run-length", turing::test::sweepRunLength},
+      {"sweep/writes", turing::test::sweepWrites},
+      {"sweep/runs", turing::test::sweepRuns},
+      {"checkpoint/resume", turing::test::checkpointResume},
+      {"checkpoint/refused", turing::test::checkpointRefused},
+      {"debugger/goto", turing::test::debuggerGoTo},
+      {"trace/truncated", turing::test::traceTruncated},
+      {"image/refused", turing::test::imageRefused},
+  };
+
+  auto checker = Checker{};
+  for (const auto &test : tests) {
+    checker.start(test.name);
+    test.run(checker);
+  }
+  return checker.failed() == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+# Checks that the machine written by --dump-optimized prints the same result
+# and exits with the same code as the original on every input.
+#
+#   cmake -DTURING=<turing> -DPROGRAMS=<dir> -DTESTS=<dir> -DWORK=<dir>
+#         -P optimizer.cmake
+
+# compare(<program> <engine> <input>...)
+function(compare program engine)
+  get_filename_component(name ${program} NAME_WE)
+  set(optimized ${WORK}/${name}-${engine}.tm)
+  execute_process(
+          COMMAND ${TURING} --engine ${engine} --dump-optimized ${optimized}
+          ${program}
+          RESULT_VARIABLE code ERROR_QUIET)
+  if (NOT code EQUAL 0)
+    message(SEND_ERROR "${name} (${engine}): --dump-optimized exited ${code}")
+    return()
+  endif ()
+  foreach (input IN LISTS ARGN)
+    if (input STREQUAL "-")
+      set(input "")
+    endif ()
+    execute_process(
+            COMMAND ${TURING} --engine ${engine} ${program} "${input}"
+            OUTPUT_VARIABLE expected RESULT_VARIABLE expectedCode
+            ERROR_QUIET)
+    execute_process(
+            COMMAND ${TURING} --engine ${engine} ${optimized} "${input}"
+            OUTPUT_VARIABLE actual RESULT_VARIABLE actualCode ERROR_QUIET)
+    if (NOT actual STREQUAL expected OR NOT actualCode EQUAL expectedCode)
+      message(SEND_ERROR "${name} (${engine}) on '${input}': "
+              "printed '${actual}' and exited ${actualCode}, "
+              "expected '${expected}' and ${expectedCode}")
+    endif ()
+  endforeach ()
+endfunction()
+
+# '-' stands for the empty input; 2 is outside every input alphabet
+compare(${PROGRAMS}/case1.tm table - 0 1 1001 0110 2)
+compare(${PROGRAMS}/case2.tm table - 1 11 1111 111111111 2)
+# the wildcard shadows a transition that only a branch of ntm takes
+compare(${TESTS}/programs/shadowed.tm table - a b ab ba aab)
+compare(${TESTS}/programs/shadowed.tm ntm - a b ab ba aab)
@@ -0,0 +1,14 @@
+#Q = {start, mark, halt}
+#S = {a, b}
+#G = {a, b, _}
+#B = _
+#q0 = start
+#F = {halt}
+#N = 1
+
+; the wildcard matches every a first, so the second transition only fires
+; on a branch of --engine ntm
+start * * r start
+start a b r mark
+mark * * r mark
+mark _ _ * halt
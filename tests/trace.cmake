@@ -0,0 +1,45 @@
+# Checks that trace-show prints a recorded run as --verbose printed it, in
+# full and over a range of steps.
+#
+#   cmake -DTURING=<turing> -DPROGRAMS=<dir> -DWORK=<dir> -P trace.cmake
+
+# replay(<program> <input> <from> <to>)
+function(replay program input from to)
+  get_filename_component(name ${program} NAME_WE)
+  set(trace ${WORK}/${name}-${input}.trace)
+  execute_process(
+          COMMAND ${TURING} --verbose ${program} "${input}"
+          OUTPUT_VARIABLE verbose ERROR_QUIET)
+  execute_process(
+          COMMAND ${TURING} --trace ${trace} ${program} "${input}"
+          RESULT_VARIABLE code OUTPUT_QUIET ERROR_QUIET)
+  if (NOT code EQUAL 0)
+    message(SEND_ERROR "${name} on '${input}': --trace exited ${code}")
+    return()
+  endif ()
+
+  execute_process(
+          COMMAND ${TURING} trace-show ${trace}
+          OUTPUT_VARIABLE shown ERROR_QUIET)
+  if (NOT shown STREQUAL verbose)
+    message(SEND_ERROR "${name} on '${input}': trace-show printed\n"
+            "${shown}\nexpected\n${verbose}")
+  endif ()
+
+  # the steps from..to are the blocks of --verbose between their headers
+  math(EXPR after "${to} + 1")
+  string(FIND "${verbose}" "Step   : ${from}\n" first)
+  string(FIND "${verbose}" "Step   : ${after}\n" last)
+  math(EXPR length "${last} - ${first}")
+  string(SUBSTRING "${verbose}" ${first} ${length} expected)
+  execute_process(
+          COMMAND ${TURING} trace-show --from ${from} --to ${to} ${trace}
+          OUTPUT_VARIABLE shown ERROR_QUIET)
+  if (NOT shown STREQUAL expected)
+    message(SEND_ERROR "${name} on '${input}': steps ${from} to ${to} "
+            "printed\n${shown}\nexpected\n${expected}")
+  endif ()
+endfunction()
+
+replay(${PROGRAMS}/case1.tm 1001 3 5)
+replay(${PROGRAMS}/case2.tm 11111 10 20)
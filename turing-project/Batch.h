@@ -0,0 +1,117 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <Simulator.h>
+
+namespace turing::simulator {
+
+// Batch runs one shared Program over many inputs on a pool of threads.
+// Inputs are cut into chunks dealt round-robin to the workers, and a worker
+// that runs out of chunks steals from the back of another worker's queue.
+// Every worker keeps a single Simulator and resets it between inputs, so its
+// tapes are reused. Results come back in input order.
+struct Batch {
+public:
+  static constexpr auto ChunkSize = Size{64};
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Size> chunks;
+  };
+
+  std::shared_ptr<const Program> program;
+  Options options;
+  Size jobs;
+
+public:
+  Batch(std::shared_ptr<const Program> program, Options options)
+      : program(std::move(program)), options(options),
+        jobs(options.jobs != 0
+                 ? options.jobs
+                 : std::max<Size>(std::thread::hardware_concurrency(), 1)) {}
+
+  static auto readInputs(std::istream &is) -> std::vector<std::string> {
+    auto inputs = std::vector<std::string>{};
+    for (auto line = std::string{}; std::getline(is, line);) {
+      inputs.emplace_back(std::move(line));
+    }
+    return inputs;
+  }
+
+  // Runs every input and returns its result, or the error message of an
+  // input that could not be run.
+  auto run(const std::vector<std::string> &inputs) const
+      -> std::vector<std::string> {
+    auto results = std::vector<std::string>(inputs.size());
+    auto chunks = (inputs.size() + ChunkSize - 1) / ChunkSize;
+    auto workers = std::min(jobs, std::max<Size>(chunks, 1));
+    auto queues = std::vector<Queue>(workers);
+    for (auto chunk = Size{0}; chunk < chunks; chunk++) {
+      queues[chunk % workers].chunks.push_back(chunk);
+    }
+
+    auto threads = std::vector<std::thread>{};
+    threads.reserve(workers);
+    for (auto worker = Size{0}; worker < workers; worker++) {
+      threads.emplace_back([&, worker] {
+        work(worker, queues, inputs, results);
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    return results;
+  }
+
+private:
+  auto work(Size self, std::vector<Queue> &queues,
+            const std::vector<std::string> &inputs,
+            std::vector<std::string> &results) const -> void {
+    auto simulator = std::move(*Simulator::of(program, SymbolsRef{}, options));
+    while (auto chunk = take(self, queues)) {
+      auto end = std::min((*chunk + 1) * ChunkSize, inputs.size());
+      for (auto i = *chunk * ChunkSize; i < end; i++) {
+        if (auto reset = simulator.reset(inputs[i]); !reset) {
+          results[i] = reset.error().message();
+          continue;
+        }
+        if (auto run = simulator.execute();
+            run.error() == TuringError::SimulatorLimitExceeded) {
+          results[i] = run.error().message();
+          continue;
+        } else if (run.error() == TuringError::SimulatorLoops) {
+          results[i] = utils::format(constants::LoopFormat, simulator.period());
+          continue;
+        }
+        results[i] = simulator.result();
+      }
+    }
+  }
+
+  // No chunk is added once the workers start, so finding every queue empty
+  // means the batch is done.
+  static auto take(Size self, std::vector<Queue> &queues)
+      -> std::optional<Size> {
+    for (auto offset = Size{0}; offset < queues.size(); offset++) {
+      auto &queue = queues[(self + offset) % queues.size()];
+      auto lock = std::lock_guard{queue.mutex};
+      if (queue.chunks.empty()) {
+        continue;
+      }
+      auto chunk = offset == 0 ? queue.chunks.front() : queue.chunks.back();
+      if (offset == 0) {
+        queue.chunks.pop_front();
+      } else {
+        queue.chunks.pop_back();
+      }
+      return chunk;
+    }
+    return std::nullopt;
+  }
+};
+
+} // namespace turing::simulator
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <limits>
+#include <optional>
+
+#include <Options.h>
+#include <Program.h>
+
+namespace turing::simulator {
+
+using machine::Steps;
+
+// Budget bounds a run by its number of steps and by wall-clock time. Engines
+// run up to the next checkpoint, at most CheckInterval steps away, and only
+// then look at the clock, so a step costs one comparison at most.
+struct Budget {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr auto CheckInterval = Steps{1} << 16;
+  static constexpr auto MaxTimeout = 1e9; // seconds, keeps the deadline finite
+
+private:
+  Steps maxSteps;
+  std::optional<Clock::time_point> deadline;
+
+public:
+  explicit Budget(const Options &options)
+      : maxSteps(options.maxSteps == 0 ? std::numeric_limits<Steps>::max()
+                                       : options.maxSteps) {
+    if (options.timeout > 0) {
+      deadline = Clock::now() +
+                 std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::duration<double>(
+                         std::min(options.timeout, MaxTimeout)));
+    }
+  }
+
+  // Steps the machine may have taken when the engine next comes back.
+  auto checkpoint(Steps step) const -> Steps {
+    if (step >= maxSteps || maxSteps - step <= CheckInterval) {
+      return maxSteps;
+    }
+    return step + CheckInterval;
+  }
+
+  // Whether a machine that halted after step steps stayed within budget.
+  auto allows(Steps step) const -> bool { return step <= maxSteps; }
+
+  // Whether a machine that has taken step steps and has not halted yet is
+  // over budget.
+  auto exceeded(Steps step) const -> bool {
+    return step >= maxSteps || (deadline && Clock::now() >= *deadline);
+  }
+};
+
+} // namespace turing::simulator
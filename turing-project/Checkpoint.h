@@ -0,0 +1,323 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if __has_include(<sys/wait.h>)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define __turing_fork__
+#else
+#include <fstream>
+#endif
+
+#include <Errors.h>
+#include <MappedFile.h>
+#include <Options.h>
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// Checkpoint is a run saved to disk, to be resumed where it stopped. It holds
+// the fingerprint of the program, the state, the step count, the input and
+// every stored cell of every tape with the heads, in the byte order of the
+// host like a compiled image:
+//
+//   Header  input  {head segments {first size cells}}
+//
+// A checkpoint is written to a temporary file first and renamed over the old
+// one, so a process dying halfway leaves the previous checkpoint intact.
+struct Checkpoint {
+public:
+  static constexpr auto Magic =
+      std::array<char, 8>{'T', 'U', 'R', 'I', 'N', 'G', 'C', 'K'};
+  static constexpr auto Version = std::uint32_t{1};
+  static constexpr auto ByteOrder = std::uint32_t{0x01020304};
+
+private:
+  struct Header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t fingerprint;
+    std::uint64_t state;
+    std::uint64_t step;
+    std::uint64_t tapes;
+    std::uint64_t inputSize;
+  };
+
+  struct Segment {
+    Position first;
+    SymbolsRef cells;
+  };
+
+  struct TapeCells {
+    Position head;
+    std::vector<Segment> segments;
+  };
+
+  std::shared_ptr<const utils::MappedFile> file;
+  Header header{};
+  SymbolsRef inputSymbols;
+  std::vector<TapeCells> tapeCells;
+
+public:
+  static auto load(utils::MappedFile mapped) -> utils::Result<Checkpoint> {
+    auto checkpoint = Checkpoint{};
+    checkpoint.file =
+        std::make_shared<const utils::MappedFile>(std::move(mapped));
+    if (!checkpoint.read(checkpoint.file->bytes())) {
+      return utils::TuringError::CheckpointInvalid;
+    }
+    return checkpoint;
+  }
+
+  auto fingerprint() const -> std::uint64_t { return header.fingerprint; }
+  auto state() const -> std::uint64_t { return header.state; }
+  auto steps() const -> Steps { return header.step; }
+  auto tapes() const -> Size { return tapeCells.size(); }
+  auto input() const -> SymbolsRef { return inputSymbols; }
+
+  // Puts the saved cells and heads on tapes, which must be as many.
+  auto restore(Tapes &tapes) const -> void {
+    for (auto i = Size{0}; i < tapeCells.size(); i++) {
+      tapes[i].load({}, 0, tapeCells[i].head);
+      for (const auto &segment : tapeCells[i].segments) {
+        tapes[i].place(segment.first, segment.cells);
+      }
+    }
+  }
+
+  // Writes a checkpoint to temp and renames it over path. Only system calls
+  // are made, so that a forked child can write it.
+  static auto save(const char *path, const char *temp,
+                   std::uint64_t fingerprint, StateId state, Steps step,
+                   SymbolsRef input, const Tapes &tapes) -> bool {
+    auto header = Header{Magic,       Version,
+                         ByteOrder,   fingerprint,
+                         state,       step,
+                         tapes.size(), input.size()};
+    auto out = Output(temp);
+    out.put(&header, sizeof(header));
+    out.put(input.data(), input.size());
+    for (const auto &tape : tapes) {
+      auto head = static_cast<std::int64_t>(tape.head());
+      auto segments = std::uint64_t{0};
+      tape.visitCells([&segments](Position, SymbolsRef) { segments++; });
+      out.put(&head, sizeof(head));
+      out.put(&segments, sizeof(segments));
+      tape.visitCells([&out](Position first, SymbolsRef cells) {
+        auto position = static_cast<std::int64_t>(first);
+        auto size = static_cast<std::uint64_t>(cells.size());
+        out.put(&position, sizeof(position));
+        out.put(&size, sizeof(size));
+        out.put(cells.data(), cells.size());
+      });
+    }
+    return out.close() && std::rename(temp, path) == 0;
+  }
+
+private:
+  Checkpoint() = default;
+
+#ifdef __turing_fork__
+  struct Output {
+    int fd;
+    bool ok;
+
+    explicit Output(const char *path)
+        : fd(::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)), ok(fd >= 0) {}
+
+    auto put(const void *data, Size size) -> void {
+      const auto *bytes = static_cast<const char *>(data);
+      while (ok && size > 0) {
+        auto written = ::write(fd, bytes, size);
+        ok = written > 0;
+        bytes += ok ? written : 0;
+        size -= ok ? static_cast<Size>(written) : size;
+      }
+    }
+
+    auto close() -> bool {
+      ok = ok && ::fsync(fd) == 0;
+      return fd >= 0 && ::close(fd) == 0 && ok;
+    }
+  };
+#else
+  struct Output {
+    std::ofstream fs;
+
+    explicit Output(const char *path) : fs(path, std::ios::binary) {}
+
+    auto put(const void *data, Size size) -> void {
+      fs.write(static_cast<const char *>(data),
+               static_cast<std::streamsize>(size));
+    }
+
+    auto close() -> bool {
+      fs.close();
+      return !fs.fail();
+    }
+  };
+#endif
+
+  auto read(std::span<const std::byte> bytes) -> bool {
+    auto at = Size{0};
+    auto take = [&bytes, &at](void *data, Size size) {
+      if (size > bytes.size() - at) {
+        return false;
+      }
+      std::memcpy(data, bytes.data() + at, size);
+      at += size;
+      return true;
+    };
+    auto cells = [&bytes, &at](Size size) -> std::optional<SymbolsRef> {
+      if (size > bytes.size() - at) {
+        return std::nullopt;
+      }
+      auto view = SymbolsRef{
+          reinterpret_cast<const Symbol *>(bytes.data() + at), size};
+      at += size;
+      return view;
+    };
+
+    if (!take(&header, sizeof(header)) || header.magic != Magic ||
+        header.version != Version || header.byteOrder != ByteOrder ||
+        header.tapes == 0 || header.tapes > bytes.size()) {
+      return false;
+    }
+    auto input = cells(header.inputSize);
+    if (!input) {
+      return false;
+    }
+    inputSymbols = *input;
+    tapeCells.resize(header.tapes);
+    for (auto &tape : tapeCells) {
+      auto head = std::int64_t{0};
+      auto segments = std::uint64_t{0};
+      if (!take(&head, sizeof(head)) || !take(&segments, sizeof(segments)) ||
+          segments > bytes.size()) {
+        return false;
+      }
+      tape.head = static_cast<Position>(head);
+      for (auto i = std::uint64_t{0}; i < segments; i++) {
+        auto first = std::int64_t{0};
+        auto size = std::uint64_t{0};
+        if (!take(&first, sizeof(first)) || !take(&size, sizeof(size))) {
+          return false;
+        }
+        auto segment = cells(size);
+        if (!segment) {
+          return false;
+        }
+        tape.segments.push_back({static_cast<Position>(first), *segment});
+      }
+    }
+    return at == bytes.size();
+  }
+};
+
+// Checkpointer saves a run every interval of wall-clock time. With fork()
+// available a child process writes the copy-on-write snapshot of the tapes
+// while the run goes on, so the step loop only stalls for the fork itself; a
+// checkpoint that comes due while the previous one is still being written is
+// skipped.
+struct Checkpointer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  std::string path;
+  std::string temp;
+  std::uint64_t fingerprint;
+  Clock::duration interval;
+  Clock::time_point next;
+#ifdef __turing_fork__
+  pid_t child = -1;
+#endif
+  bool failed = false;
+
+public:
+  Checkpointer(const Options &options, std::uint64_t fingerprint)
+      : path(options.checkpoint), temp(path + ".tmp"), fingerprint(fingerprint),
+        interval(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.checkpointEvery))),
+        next(Clock::now() + interval) {}
+
+  Checkpointer(const Checkpointer &) = delete;
+  auto operator=(const Checkpointer &) -> Checkpointer & = delete;
+
+  ~Checkpointer() { wait(); }
+
+  // Saves the run if a checkpoint is due.
+  auto tick(StateId state, Steps step, SymbolsRef input, const Tapes &tapes)
+      -> void {
+    if (Clock::now() < next || busy()) {
+      return;
+    }
+    next = Clock::now() + interval;
+#ifdef __turing_fork__
+    if (auto pid = ::fork(); pid == 0) {
+      ::_exit(Checkpoint::save(path.c_str(), temp.c_str(), fingerprint, state,
+                               step, input, tapes)
+                  ? 0
+                  : 1);
+    } else if (pid > 0) {
+      child = pid;
+      return;
+    }
+#endif
+    failed = failed || !Checkpoint::save(path.c_str(), temp.c_str(),
+                                         fingerprint, state, step, input,
+                                         tapes);
+  }
+
+  // Saves the run at once, after the checkpoint being written if any.
+  auto save(StateId state, Steps step, SymbolsRef input, const Tapes &tapes)
+      -> void {
+    wait();
+    failed = failed || !Checkpoint::save(path.c_str(), temp.c_str(),
+                                         fingerprint, state, step, input,
+                                         tapes);
+  }
+
+  // Waits for the checkpoint being written, and tells whether every
+  // checkpoint so far was written.
+  auto wait() -> bool {
+#ifdef __turing_fork__
+    if (child > 0) {
+      auto status = 0;
+      failed = failed || ::waitpid(child, &status, 0) != child ||
+               !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+      child = -1;
+    }
+#endif
+    return !failed;
+  }
+
+private:
+  auto busy() -> bool {
+#ifdef __turing_fork__
+    if (child > 0) {
+      auto status = 0;
+      auto done = ::waitpid(child, &status, WNOHANG);
+      if (done == 0) {
+        return true;
+      }
+      failed = failed || done != child || !WIFEXITED(status) ||
+               WEXITSTATUS(status) != 0;
+      child = -1;
+    }
+#endif
+    return false;
+  }
+};
+
+} // namespace turing::simulator
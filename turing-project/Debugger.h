@@ -0,0 +1,222 @@
+#pragma once
+#include <istream>
+
+#include <Simulator.h>
+
+namespace turing::simulator {
+
+namespace constants {
+
+constexpr auto DebugCommands =
+    "commands: step|s [n], back|b [n], goto|g <step>, continue|c, print|p, "
+    "quit|q";
+constexpr auto DebugHaltedFormat = "halted after {} steps: {}";
+
+} // namespace constants
+
+// Debugger steps a run forward and backward on commands read one per line,
+// from a terminal or a script. Every step forward appends to an undo log the
+// state it left, the action it took and the symbols it overwrote, so a step
+// back writes one cell per tape and costs O(1). The log holds the last
+// LogLimit steps. Further back, the run starts over from the last snapshot of
+// the tapes before the target and steps forward. A snapshot is taken every
+// so many steps, and once there are SnapshotLimit of them every other one is
+// dropped and the distance doubles, so memory stays bounded however long the
+// run while a jump costs at most the distance between snapshots.
+struct Debugger {
+public:
+  static constexpr auto LogLimit = Size{1} << 20;
+  static constexpr auto SnapshotLimit = Size{64};
+  static constexpr auto FirstSnapshotEvery = Steps{1} << 16;
+
+private:
+  struct Snapshot {
+    Steps step;
+    StateId state;
+    Tapes tapes;
+  };
+
+  const Logger &logger;
+  std::shared_ptr<const Program> program;
+  Options options;
+  std::string indent;
+  StateId currentState;
+  Tapes _tapes;
+  Steps step = 0;
+
+  // the undo log of the steps after logStart, one entry per step
+  Steps logStart = 0;
+  std::vector<StateId> fromStates;
+  std::vector<ActionId> actions;
+  Symbols overwritten; // one symbol per tape and step
+
+  std::vector<Snapshot> snapshots; // by step, the first one at step 0
+  Steps snapshotEvery = FirstSnapshotEvery;
+
+public:
+  Debugger(std::shared_ptr<const Program> program, SymbolsRef input,
+           Options options)
+      : logger(Logger::instance()), program(std::move(program)),
+        options(options), indent(Simulator::indentOf(this->program->tapes())),
+        currentState(this->program->initialState()),
+        _tapes(this->program->tapes(), this->program->blankSymbol(), input) {
+    snapshots.push_back({step, currentState, _tapes});
+  }
+
+  // Runs the commands of in until it ends or says quit, printing the
+  // configuration reached after each of them.
+  auto serve(std::istream &in) -> void {
+    show();
+    for (auto line = std::string{}; std::getline(in, line);) {
+      auto words = utils::split(utils::trim(line), ' ');
+      utils::omitEmpty(words);
+      if (words.empty()) {
+        continue;
+      }
+      auto command = words[0];
+      auto count = std::optional<Steps>{1};
+      if (words.size() > 1) {
+        count = utils::toNumber<Steps>(words[1]);
+      }
+      if (command == "q" || command == "quit") {
+        return;
+      }
+      if (!count || words.size() > 2) {
+        logger.error("invalid command: {}", line);
+        continue;
+      }
+      if (command == "s" || command == "step") {
+        forward(*count);
+      } else if (command == "b" || command == "back") {
+        goTo(step - std::min(step, *count));
+      } else if ((command == "g" || command == "goto") && words.size() == 2) {
+        goTo(*count);
+      } else if ((command == "c" || command == "continue") &&
+                 words.size() == 1) {
+        finish();
+      } else if (!(command == "p" || command == "print") ||
+                 words.size() != 1) {
+        logger.error("invalid command: {}", line);
+        logger.error(constants::DebugCommands);
+        continue;
+      }
+      show();
+    }
+  }
+
+  auto steps() const -> Steps { return step; }
+  auto tapes() const -> const Tapes & { return _tapes; }
+  auto state() const -> StateRef { return program->stateName(currentState); }
+
+  // Moves to step target, or as far towards it as the machine runs.
+  auto goTo(Steps target) -> void {
+    if (target < logStart) {
+      auto after = std::upper_bound(
+          snapshots.begin(), snapshots.end(), target,
+          [](Steps step, const Snapshot &snapshot) {
+            return step < snapshot.step;
+          });
+      const auto &snapshot = *std::prev(after);
+      step = snapshot.step;
+      currentState = snapshot.state;
+      _tapes = snapshot.tapes;
+      logStart = step;
+      fromStates.clear();
+      actions.clear();
+      overwritten.clear();
+    }
+    while (step > target) {
+      undo();
+    }
+    forward(target - step);
+  }
+
+private:
+  // Takes up to count steps, fewer if the machine halts.
+  auto forward(Steps count) -> void {
+    for (; count > 0 && advance(); count--) {
+    }
+  }
+
+  // Runs until the machine halts or the budget of the options runs out.
+  auto finish() -> void {
+    auto budget = Budget(options);
+    for (auto moving = true; moving && !budget.exceeded(step);) {
+      for (auto checkpoint = budget.checkpoint(step);
+           moving && step < checkpoint;) {
+        moving = advance();
+      }
+    }
+  }
+
+  auto advance() -> bool {
+    if (program->accepts(currentState)) {
+      return false;
+    }
+    auto action = program->find(currentState, _tapes);
+    if (action == Program::NoAction) {
+      return false;
+    }
+    if (actions.size() == LogLimit) {
+      forget(LogLimit / 2);
+    }
+    fromStates.push_back(currentState);
+    actions.push_back(action);
+    for (const auto &tape : _tapes) {
+      overwritten.push_back(tape.read());
+    }
+    _tapes.write(program->output(action), program->move(action));
+    currentState = program->next(action);
+    step++;
+    if (step % snapshotEvery == 0 && step > snapshots.back().step) {
+      snapshot();
+    }
+    return true;
+  }
+
+  auto undo() -> void {
+    auto width = _tapes.size();
+    _tapes.unwrite(SymbolsRef{overwritten}.substr(overwritten.size() - width),
+                  program->move(actions.back()));
+    currentState = fromStates.back();
+    fromStates.pop_back();
+    actions.pop_back();
+    overwritten.resize(overwritten.size() - width);
+    step--;
+  }
+
+  // Drops the oldest count entries of the undo log.
+  auto forget(Size count) -> void {
+    fromStates.erase(fromStates.begin(),
+                     fromStates.begin() + static_cast<std::ptrdiff_t>(count));
+    actions.erase(actions.begin(),
+                  actions.begin() + static_cast<std::ptrdiff_t>(count));
+    overwritten.erase(0, count * _tapes.size());
+    logStart += count;
+  }
+
+  auto snapshot() -> void {
+    snapshots.push_back({step, currentState, _tapes});
+    if (snapshots.size() <= SnapshotLimit) {
+      return;
+    }
+    snapshotEvery *= 2;
+    std::erase_if(snapshots, [this](const Snapshot &snapshot) {
+      return snapshot.step % snapshotEvery != 0;
+    });
+  }
+
+  auto show() const -> void {
+    logger.info(constants::RunInformationFormat, indent, step, indent,
+                program->stateName(currentState), _tapes);
+    if (program->accepts(currentState) ||
+        program->find(currentState, _tapes) == Program::NoAction) {
+      logger.info(constants::DebugHaltedFormat, step,
+                  program->accepts(currentState) ? "accepted" : "not accepted");
+    }
+    // a terminal waits for the answer before the next command
+    logger.flush();
+  }
+};
+
+} // namespace turing::simulator
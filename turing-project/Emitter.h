@@ -0,0 +1,399 @@
+#pragma once
+#include <map>
+#include <ostream>
+#include <unordered_map>
+
+#include <Program.h>
+
+namespace turing::machine {
+
+namespace constants {
+
+// Everything the generated program needs besides the machine itself. The
+// configuration printed in verbose mode mirrors Tape::toString and the
+// formats of Simulator.
+constexpr auto EmittedIncludes = R"(#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+)";
+
+constexpr auto EmittedPrelude = R"(
+struct Tape {
+  char *cells;
+  long size;
+  long head;   // index of the head in cells
+  long origin; // index of position 0 in cells
+};
+
+auto makeTape(const std::string &symbols) -> Tape {
+  auto size = std::max<long>(static_cast<long>(symbols.size()), 1);
+  auto *cells = static_cast<char *>(std::malloc(size));
+  std::memset(cells, Blank, size);
+  std::memcpy(cells, symbols.data(), symbols.size());
+  return Tape{cells, size, 0, 0};
+}
+
+// Doubles the tape on the side the head just ran off.
+[[gnu::noinline]] auto growLeft(Tape tape) -> Tape {
+  auto *cells = static_cast<char *>(std::malloc(tape.size * 2));
+  std::memset(cells, Blank, tape.size);
+  std::memcpy(cells + tape.size, tape.cells, tape.size);
+  std::free(tape.cells);
+  return Tape{cells, tape.size * 2, tape.head + tape.size,
+              tape.origin + tape.size};
+}
+
+[[gnu::noinline]] auto growRight(Tape tape) -> Tape {
+  tape.cells = static_cast<char *>(std::realloc(tape.cells, tape.size * 2));
+  std::memset(tape.cells + tape.size, Blank, tape.size);
+  tape.size *= 2;
+  return tape;
+}
+
+auto digits(long n) -> std::size_t { return std::to_string(n).size(); }
+
+auto result(const Tape &tape) -> std::string {
+  auto first = 0L;
+  auto last = tape.size - 1;
+  while (first <= last && tape.cells[first] == Blank) {
+    first++;
+  }
+  while (last >= first && tape.cells[last] == Blank) {
+    last--;
+  }
+  return std::string(tape.cells + first, tape.cells + last + 1);
+}
+
+auto render(const Tape &tape, std::size_t index) -> std::string {
+  auto indent = std::string(digits(TapeCount) - digits(index), ' ');
+  auto first = 0L;
+  auto last = tape.size - 1;
+  while (first <= last && tape.cells[first] == Blank) {
+    first++;
+  }
+  while (last >= first && tape.cells[last] == Blank) {
+    last--;
+  }
+  if (first > last) {
+    first = last = tape.head;
+  }
+  first = std::min(first, tape.head);
+  last = std::max(last, tape.head);
+
+  std::string lines[3];
+  for (auto cell = first; cell <= last; cell++) {
+    std::string column[3] = {std::to_string(std::labs(cell - tape.origin)),
+                             std::string(1, tape.cells[cell]),
+                             cell == tape.head ? "^" : " "};
+    auto width = std::max({column[0].size(), column[1].size(), std::size_t{1}});
+    for (auto i = 0; i < 3; i++) {
+      if (cell != first) {
+        lines[i] += ' ';
+      }
+      lines[i] += column[i] + std::string(width - column[i].size(), ' ');
+    }
+  }
+  auto name = std::to_string(index) + indent;
+  return "Index" + name + " : " + lines[0] + "\n" + "Tape" + name + "  : " +
+         lines[1] + "\n" + "Head" + name + "  : " + lines[2];
+}
+
+auto configuration(const Tape *tapes, std::uint64_t steps,
+                   std::uint32_t state) -> std::string {
+  auto indent = std::string(digits(TapeCount), ' ');
+  auto text = "Step  " + indent + ": " + std::to_string(steps) + "\n" +
+              "State " + indent + ": " + StateNames[state] + "\n";
+  for (auto i = 0; i < TapeCount; i++) {
+    text += render(tapes[i], i) + "\n";
+  }
+  return text + "---------------------------------------------";
+}
+
+)";
+
+constexpr auto EmittedMain = R"(
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+  auto verbose = false;
+  auto input = std::string{};
+  for (auto i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-v") == 0 ||
+        std::strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else if (input.empty()) {
+      input = argv[i];
+    }
+  }
+
+  for (auto i = std::size_t{0}; i < input.size(); i++) {
+    if (!isInputSymbol(input[i])) {
+      if (verbose) {
+        std::fprintf(stderr,
+                     "Input: %s\n"
+                     "==================== ERR ====================\n"
+                     "error: '%c' was not declared in the set of input "
+                     "symbols\n"
+                     "Input: %s\n"
+                     "       %s^\n"
+                     "==================== END ====================\n",
+                     input.c_str(), input[i], input.c_str(),
+                     std::string(i, ' ').c_str());
+      }
+      std::fputs("illegal input\n", stderr);
+      return IllegalInput;
+    }
+  }
+
+  Tape tapes[TapeCount];
+  tapes[0] = makeTape(input);
+  for (auto i = 1; i < TapeCount; i++) {
+    tapes[i] = makeTape({});
+  }
+  if (verbose) {
+    std::printf("Input: %s\n"
+                "==================== RUN ====================\n%s\n",
+                input.c_str(), configuration(tapes, 0, InitialState).c_str());
+  }
+
+  auto steps = std::uint64_t{0};
+  verbose ? run<true>(tapes, steps) : run<false>(tapes, steps);
+  auto tape = result(tapes[0]);
+  if (verbose) {
+    std::printf("Result: %s\n"
+                "==================== END ====================\n",
+                tape.c_str());
+  } else {
+    std::printf("%s\n", tape.c_str());
+  }
+  for (auto &t : tapes) {
+    std::free(t.cells);
+  }
+  return 0;
+}
+)";
+
+} // namespace constants
+
+// Emitter writes a machine out as a standalone C++ program. Every state
+// becomes a label, the symbols under the heads are tested by nested switches
+// with the symbols compiled in, and the tape count is a constant, so a step
+// is a few compares, stores and one jump. Transitions are matched with the
+// same precedence and wildcard rules as Program, so the generated program
+// prints what Simulator::run prints, in verbose mode every configuration
+// included. The run is emitted once for each mode, so the plain one carries
+// no check for it.
+struct Emitter {
+private:
+  struct Candidate {
+    SymbolsRef input;
+    ActionId action;
+  };
+
+  const TuringState &state;
+  Program program;
+  std::ostream &os;
+  std::unordered_map<StateRef, StateId> stateIds;
+  std::vector<std::vector<Candidate>> rows; // per state, in declaration order
+  SymbolSet starSymbols;
+
+public:
+  Emitter(const TuringState &state, std::ostream &os)
+      : state(state), program(Program::compile(state)), os(os) {
+    for (auto id = StateId{0}; id < program.states(); id++) {
+      stateIds.emplace(program.stateName(id), id);
+    }
+    starSymbols = state.tapeSymbols;
+    starSymbols.erase(state.blankSymbol);
+
+    // like Program::compile, wildcards without any symbol to stand for
+    // drop the whole transition
+    rows.resize(program.states());
+    auto action = ActionId{0};
+    for (const auto &transition : state.transitions) {
+      if (!starSymbols.empty() || !transition.isStarTransition()) {
+        rows[stateIds.at(transition.currentState())].push_back(
+            {transition.inputSymbols(), action});
+      }
+      action++;
+    }
+  }
+
+  auto emit() -> void {
+    os << "// Generated by turing --emit-cpp, do not edit.\n"
+       << constants::EmittedIncludes << "\nnamespace {\n\n"
+       << "constexpr auto TapeCount = " << program.tapes() << ";\n"
+       << "constexpr auto Blank = " << literal(program.blankSymbol()) << ";\n"
+       << "constexpr auto InitialState = std::uint32_t{"
+       << program.initialState() << "};\n"
+       << "constexpr auto IllegalInput = "
+       << static_cast<int>(utils::TuringError::SimulatorIllegalInput) << ";\n"
+       << "constexpr const char *StateNames[] = {";
+    for (auto id = StateId{0}; id < program.states(); id++) {
+      os << (id == 0 ? "" : ", ") << '"' << program.stateName(id) << '"';
+    }
+    os << "};\n" << constants::EmittedPrelude;
+    emitInputSymbols();
+    emitRun();
+    os << constants::EmittedMain;
+  }
+
+private:
+  static auto literal(Symbol symbol) -> std::string {
+    if (symbol == '\'' || symbol == '\\') {
+      return std::string{'\'', '\\', symbol, '\''};
+    }
+    return std::string{'\'', symbol, '\''};
+  }
+
+  auto indent(Size depth) -> std::ostream & {
+    return os << std::string(depth * 2, ' ');
+  }
+
+  auto emitInputSymbols() -> void {
+    os << "auto isInputSymbol(char symbol) -> bool {\n"
+       << "  switch (symbol) {\n";
+    for (auto symbol : state.symbols) {
+      os << "  case " << literal(symbol) << ":\n";
+    }
+    os << "    return true;\n"
+       << "  default:\n"
+       << "    return false;\n"
+       << "  }\n"
+       << "}\n\n";
+  }
+
+  auto emitRun() -> void {
+    // only states some transition enters get a label, so that none is unused
+    auto entered = std::vector<bool>(program.states(), false);
+    entered[program.initialState()] = true;
+    for (auto action = ActionId{0}; action < program.actions(); action++) {
+      entered[program.next(action)] = true;
+    }
+
+    os << "// Runs until the machine halts, returning the state it halted in,\n"
+       << "// and prints the configuration after every step when Verbose.\n"
+       << "template <bool Verbose>\n"
+       << "auto run(Tape *tapes, std::uint64_t &totalSteps) -> std::uint32_t "
+          "{\n";
+    for (auto i = Size{0}; i < program.tapes(); i++) {
+      os << "  auto t" << i << " = tapes[" << i << "];\n";
+    }
+    os << "  auto show = [&](std::uint64_t steps, std::uint32_t state) {\n"
+       << "    if constexpr (Verbose) {\n";
+    for (auto i = Size{0}; i < program.tapes(); i++) {
+      os << "      tapes[" << i << "] = t" << i << ";\n";
+    }
+    os << "      std::printf(\"%s\\n\", "
+          "configuration(tapes, steps, state).c_str());\n"
+       << "    }\n"
+       << "  };\n";
+    os << "  auto steps = std::uint64_t{0};\n"
+       << "  auto state = std::uint32_t{0};\n"
+       << "  goto s" << program.initialState() << ";\n\n";
+
+    for (auto id = StateId{0}; id < program.states(); id++) {
+      if (!entered[id]) {
+        continue;
+      }
+      os << "s" << id << ": // " << program.stateName(id) << '\n';
+      if (program.accepts(id) || rows[id].empty()) {
+        os << "  state = " << id << ";\n"
+           << "  goto stop;\n";
+        continue;
+      }
+      emitMatch(id, rows[id], 0, 1);
+    }
+
+    os << "\nstop:\n";
+    for (auto i = Size{0}; i < program.tapes(); i++) {
+      os << "  tapes[" << i << "] = t" << i << ";\n";
+    }
+    os << "  totalSteps = steps;\n"
+       << "  return state;\n"
+       << "}\n";
+  }
+
+  // Picks among the candidates by the symbol under head tape, one switch
+  // per tape. Symbols that leave the same candidates share a case.
+  auto emitMatch(StateId id, const std::vector<Candidate> &candidates,
+                 Size tape, Size depth) -> void {
+    if (tape == program.tapes()) {
+      emitAction(candidates.front().action, depth);
+      return;
+    }
+
+    auto groups = std::map<std::vector<ActionId>, Symbols>{};
+    auto order = std::vector<std::vector<ActionId>>{};
+    for (auto symbolId = Size{0}; symbolId < program.symbols(); symbolId++) {
+      auto symbol = program.symbol(static_cast<SymbolId>(symbolId));
+      auto actions = std::vector<ActionId>{};
+      for (const auto &candidate : candidates) {
+        auto expected = candidate.input[tape];
+        if (expected == symbol || (expected == Transition::Wildcard &&
+                                   starSymbols.contains(symbol))) {
+          actions.push_back(candidate.action);
+        }
+      }
+      if (actions.empty()) {
+        continue;
+      }
+      auto [it, inserted] = groups.try_emplace(actions);
+      if (inserted) {
+        order.push_back(actions);
+      }
+      it->second.push_back(symbol);
+    }
+
+    indent(depth) << "switch (t" << tape << ".cells[t" << tape
+                  << ".head]) {\n";
+    for (const auto &actions : order) {
+      for (auto symbol : groups.at(actions)) {
+        indent(depth) << "case " << literal(symbol) << ":\n";
+      }
+      auto matched = std::vector<Candidate>{};
+      for (const auto &candidate : candidates) {
+        if (std::find(actions.begin(), actions.end(), candidate.action) !=
+            actions.end()) {
+          matched.push_back(candidate);
+        }
+      }
+      emitMatch(id, matched, tape + 1, depth + 1);
+    }
+    indent(depth) << "default:\n";
+    indent(depth + 1) << "state = " << id << ";\n";
+    indent(depth + 1) << "goto stop;\n";
+    indent(depth) << "}\n";
+  }
+
+  auto emitAction(ActionId action, Size depth) -> void {
+    auto output = program.output(action);
+    auto moves = program.move(action);
+    indent(depth) << "// " << state.transitions[action].toString() << '\n';
+    for (auto i = Size{0}; i < program.tapes(); i++) {
+      if (output[i] != Transition::Wildcard) {
+        indent(depth) << "t" << i << ".cells[t" << i
+                      << ".head] = " << literal(output[i]) << ";\n";
+      }
+    }
+    for (auto i = Size{0}; i < program.tapes(); i++) {
+      if (moves[i] == Move::Left) {
+        indent(depth) << "if (--t" << i << ".head < 0) {\n";
+        indent(depth + 1) << "t" << i << " = growLeft(t" << i << ");\n";
+        indent(depth) << "}\n";
+      } else if (moves[i] == Move::Right) {
+        indent(depth) << "if (++t" << i << ".head == t" << i << ".size) {\n";
+        indent(depth + 1) << "t" << i << " = growRight(t" << i << ");\n";
+        indent(depth) << "}\n";
+      }
+    }
+    indent(depth) << "steps++;\n";
+    indent(depth) << "show(steps, " << program.next(action) << ");\n";
+    indent(depth) << "goto s" << program.next(action) << ";\n";
+  }
+};
+
+} // namespace turing::machine
@@ -17,6 +17,16 @@ enum struct TuringError : int {
   ParserDuplicateDefinition,
   SimulatorIllegalInput,
   SimulatorNotAccepted,
+  SimulatorUnsupportedMachine,
+  ImageInvalid,
+  ImageUnsupportedMachine,
+  SimulatorLimitExceeded,
+  SimulatorLoops,
+  TraceInvalid,
+  CheckpointInvalid,
+  CheckpointMismatch,
+  ProfileInvalid,
+  FileUnreadable,
   UnknownError
 };
 
@@ -46,6 +56,25 @@ struct ErrorCategory final : public std::error_category {
       return "illegal input";
     case TuringError::SimulatorNotAccepted:
       return "not accepted";
+    case TuringError::SimulatorUnsupportedMachine:
+    case TuringError::ImageUnsupportedMachine:
+      return "unsupported machine";
+    case TuringError::ImageInvalid:
+      return "invalid image";
+    case TuringError::SimulatorLimitExceeded:
+      return "limit exceeded";
+    case TuringError::SimulatorLoops:
+      return "loops";
+    case TuringError::TraceInvalid:
+      return "invalid trace";
+    case TuringError::CheckpointInvalid:
+      return "invalid checkpoint";
+    case TuringError::CheckpointMismatch:
+      return "checkpoint of another machine";
+    case TuringError::ProfileInvalid:
+      return "invalid profile";
+    case TuringError::FileUnreadable:
+      return "failed to open file";
     default:
       return "unknown error";
     }
@@ -0,0 +1,384 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include <Budget.h>
+#include <Machine.h>
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// Explorer runs a machine nondeterministically: every transition that matches
+// a configuration is taken, not only the first one declared. Configurations
+// are explored breadth-first, one level per step. Large levels are cut into
+// chunks that the workers of a pool, started once per run, take from the
+// shared frontier. The children of every chunk are kept in order, so the
+// outcome does not depend on the number of threads. A configuration seen
+// before is dropped, so a machine whose every branch loops is rejected.
+// Configurations are looked up by fingerprint and compared in full when
+// fingerprints match, so a collision never drops a live branch.
+//
+// The run accepts with the first accepting configuration of the shallowest
+// level, and otherwise ends with the first branch that halted last.
+struct Explorer {
+public:
+  enum class Halt { Accepted, Stopped, Exceeded };
+
+  struct Outcome {
+    Halt halt;
+    StateId state;
+    Steps steps;
+    Tapes tapes;
+  };
+
+  static constexpr auto ChunkSize = Size{64};
+  // Levels smaller than this are expanded without waking the workers.
+  static constexpr auto ParallelLevel = ChunkSize * 4;
+
+private:
+  struct Configuration {
+    StateId state;
+    Tapes tapes;
+    Hash fingerprint = 0; // set by seal() once state and tapes are final
+
+    auto seal() -> void {
+      fingerprint = tapes.hash() ^ (Hash{state} + 1) * 0x9e3779b97f4a7c15;
+    }
+
+    // The state, the heads and the non-blank cells of every tape, in a
+    // string equal to that of another configuration exactly when the two
+    // are the same.
+    auto pack() const -> std::string {
+      auto packed = std::string{};
+      auto put = [&packed](auto value) {
+        packed.append(reinterpret_cast<const char *>(&value), sizeof value);
+      };
+      put(state);
+      for (const auto &tape : tapes) {
+        auto cells = tape.result();
+        put(tape.head());
+        put(tape.firstSymbol().value_or(0));
+        put(cells.size());
+        packed += cells;
+      }
+      return packed;
+    }
+  };
+
+  // Every configuration seen, packed and filed by fingerprint, split into
+  // shards by the top bits of the fingerprint. A shard is only ever touched
+  // by one thread at a time.
+  struct Seen {
+    static constexpr auto ShardBits = 6;
+
+    std::vector<std::unordered_multimap<Hash, std::string>> shards;
+
+    Seen() : shards(Size{1} << ShardBits) {}
+
+    static auto shard(Hash fingerprint) -> Size {
+      return static_cast<Size>(fingerprint >> (64 - ShardBits));
+    }
+
+    // Keeps configuration and tells whether it is new.
+    auto insert(const Configuration &configuration) -> bool {
+      auto &configurations = shards[shard(configuration.fingerprint)];
+      auto packed = configuration.pack();
+      auto [first, last] =
+          configurations.equal_range(configuration.fingerprint);
+      for (; first != last; ++first) {
+        if (first->second == packed) {
+          return false;
+        }
+      }
+      configurations.emplace(configuration.fingerprint, std::move(packed));
+      return true;
+    }
+  };
+
+  // Pool keeps jobs - 1 threads for a whole run and wakes them for every
+  // parallel phase of a level, so deep runs pay for starting them once.
+  struct Pool {
+  private:
+    std::mutex mutex;
+    std::condition_variable started;  // a phase began, or the pool stops
+    std::condition_variable finished; // the last worker ended its part
+    std::function<void(Size)> work;
+    Size phase = 0;
+    Size running = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+  public:
+    explicit Pool(Size jobs) {
+      threads.reserve(jobs - 1);
+      for (auto worker = Size{1}; worker < jobs; worker++) {
+        threads.emplace_back([this, worker] { serve(worker); });
+      }
+    }
+
+    Pool(const Pool &) = delete;
+    auto operator=(const Pool &) -> Pool & = delete;
+
+    ~Pool() {
+      {
+        auto lock = std::lock_guard{mutex};
+        stopping = true;
+      }
+      started.notify_all();
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+
+    // Runs task(worker) on every thread, the calling one as worker 0, and
+    // returns once all of them are done.
+    auto run(std::function<void(Size)> task) -> void {
+      {
+        auto lock = std::lock_guard{mutex};
+        work = std::move(task);
+        running = threads.size();
+        phase++;
+      }
+      started.notify_all();
+      work(0);
+      auto lock = std::unique_lock{mutex};
+      finished.wait(lock, [this] { return running == 0; });
+    }
+
+  private:
+    auto serve(Size worker) -> void {
+      for (auto done = Size{0};;) {
+        {
+          auto lock = std::unique_lock{mutex};
+          started.wait(lock, [&] { return stopping || phase != done; });
+          if (stopping) {
+            return;
+          }
+          done = phase;
+        }
+        work(worker);
+        auto lock = std::lock_guard{mutex};
+        if (--running == 0) {
+          finished.notify_one();
+        }
+      }
+    }
+  };
+
+  std::shared_ptr<const Program> program;
+  std::vector<std::vector<ActionId>> alternatives; // per state
+  std::vector<Symbols> inputs;                     // per action
+  Size jobs;
+
+public:
+  // machine is the source program was compiled from; compiled images keep
+  // only the first transition of every state and symbols.
+  Explorer(std::shared_ptr<const Program> program, const TuringState &machine,
+           Size jobs)
+      : program(std::move(program)),
+        alternatives(this->program->states()),
+        jobs(jobs != 0 ? jobs
+                       : std::max<Size>(std::thread::hardware_concurrency(),
+                                        1)) {
+    auto stateIds = std::unordered_map<StateRef, StateId>{};
+    for (auto state = StateId{0}; state < this->program->states(); state++) {
+      stateIds.emplace(this->program->stateName(state), state);
+    }
+    for (auto action = ActionId{0}; action < machine.transitions.size();
+         action++) {
+      const auto &transition = machine.transitions[action];
+      alternatives[stateIds.at(transition.currentState())].push_back(action);
+      inputs.emplace_back(transition.inputSymbols());
+    }
+  }
+
+  static auto supports(const Program &program, const TuringState &machine)
+      -> bool {
+    return machine.transitions.size() == program.actions();
+  }
+
+  auto run(SymbolsRef input, const Budget &budget) const -> Outcome {
+    auto start = Configuration{
+        program->initialState(),
+        Tapes(program->tapes(), program->blankSymbol(), input)};
+    start.tapes.trackHash();
+    start.seal();
+    auto seen = Seen{};
+    seen.insert(start);
+    auto pool = std::optional<Pool>{};
+
+    auto level = std::vector<Configuration>{};
+    level.push_back(std::move(start));
+    auto halted = std::optional<Configuration>{};
+    auto haltedAt = Steps{0};
+    for (auto depth = Steps{0};; depth++) {
+      for (auto &configuration : level) {
+        if (program->accepts(configuration.state)) {
+          return finish(Halt::Accepted, depth, std::move(configuration));
+        }
+      }
+      if (budget.exceeded(depth)) {
+        // a level that halts altogether at the limit still stops
+        auto moving = std::any_of(level.begin(), level.end(),
+                                  [this](const auto &configuration) {
+                                    return firstMatch(configuration) !=
+                                           Program::NoAction;
+                                  });
+        if (moving) {
+          return finish(Halt::Exceeded, depth, std::move(level.front()));
+        }
+      }
+
+      auto haltedNow = std::optional<Configuration>{};
+      auto next = expand(level, haltedNow, workers(level.size(), pool));
+      if (haltedNow) {
+        halted = std::move(haltedNow);
+        haltedAt = depth;
+      }
+      deduplicate(next, seen, workers(next.size(), pool));
+      if (next.empty()) {
+        return halted ? finish(Halt::Stopped, haltedAt, std::move(*halted))
+                      : finish(Halt::Stopped, depth, std::move(level.front()));
+      }
+      level = std::move(next);
+    }
+  }
+
+private:
+  static auto finish(Halt halt, Steps steps, Configuration &&configuration)
+      -> Outcome {
+    return {halt, configuration.state, steps, std::move(configuration.tapes)};
+  }
+
+  // The pool to share a level of size configurations, started by the first
+  // level large enough, or null when the calling thread does better alone.
+  auto workers(Size size, std::optional<Pool> &pool) const -> Pool * {
+    if (size < ParallelLevel || jobs == 1) {
+      return nullptr;
+    }
+    if (!pool) {
+      pool.emplace(jobs);
+    }
+    return &*pool;
+  }
+
+  auto firstMatch(const Configuration &configuration) const -> ActionId {
+    auto heads = Symbols{};
+    auto symbols = configuration.tapes.read(heads);
+    for (auto action : alternatives[configuration.state]) {
+      if (program->matches(inputs[action], symbols)) {
+        return action;
+      }
+    }
+    return Program::NoAction;
+  }
+
+  // Appends the children of configuration to children, in the order the
+  // transitions were declared, and tells whether it had any.
+  auto branch(const Configuration &configuration,
+              std::vector<Configuration> &children) const -> bool {
+    auto heads = Symbols{};
+    auto symbols = configuration.tapes.read(heads);
+    auto any = false;
+    for (auto action : alternatives[configuration.state]) {
+      if (!program->matches(inputs[action], symbols)) {
+        continue;
+      }
+      any = true;
+      auto &child = children.emplace_back(configuration);
+      child.tapes.write(program->output(action), program->move(action));
+      child.state = program->next(action);
+      child.seal();
+    }
+    return any;
+  }
+
+  // The next level, with the first configuration of this one that halted in
+  // halted if any did.
+  auto expand(const std::vector<Configuration> &level,
+              std::optional<Configuration> &halted, Pool *pool) const
+      -> std::vector<Configuration> {
+    auto chunks = (level.size() + ChunkSize - 1) / ChunkSize;
+    auto children = std::vector<std::vector<Configuration>>(chunks);
+    auto firstHalted = std::vector<Size>(chunks, level.size());
+    auto expandChunk = [&](Size chunk) {
+      auto end = std::min((chunk + 1) * ChunkSize, level.size());
+      for (auto i = chunk * ChunkSize; i < end; i++) {
+        if (!branch(level[i], children[chunk]) &&
+            firstHalted[chunk] == level.size()) {
+          firstHalted[chunk] = i;
+        }
+      }
+    };
+    if (pool == nullptr) {
+      for (auto chunk = Size{0}; chunk < chunks; chunk++) {
+        expandChunk(chunk);
+      }
+    } else {
+      auto taken = std::atomic<Size>{0};
+      pool->run([&](Size) {
+        for (auto chunk = taken++; chunk < chunks; chunk = taken++) {
+          expandChunk(chunk);
+        }
+      });
+    }
+
+    auto first = *std::min_element(firstHalted.begin(), firstHalted.end());
+    if (first != level.size()) {
+      halted = level[first];
+    }
+    auto next = std::vector<Configuration>{};
+    auto total = Size{0};
+    for (const auto &chunk : children) {
+      total += chunk.size();
+    }
+    next.reserve(total);
+    for (auto &chunk : children) {
+      std::move(chunk.begin(), chunk.end(), std::back_inserter(next));
+    }
+    return next;
+  }
+
+  // Drops from next every configuration seen before, keeping the first of
+  // equal ones. Every worker owns some of the shards and walks the whole
+  // level in order, so the survivors do not depend on timing.
+  auto deduplicate(std::vector<Configuration> &next, Seen &seen,
+                   Pool *pool) const -> void {
+    auto fresh = std::vector<char>(next.size(), 0);
+    auto mark = [&](Size worker, Size workers) {
+      for (auto i = Size{0}; i < next.size(); i++) {
+        if (Seen::shard(next[i].fingerprint) % workers == worker) {
+          fresh[i] = seen.insert(next[i]) ? 1 : 0;
+        }
+      }
+    };
+    if (pool == nullptr) {
+      mark(0, 1);
+    } else {
+      pool->run([&](Size worker) { mark(worker, jobs); });
+    }
+
+    auto kept = Size{0};
+    for (auto i = Size{0}; i < next.size(); i++) {
+      if (fresh[i] != 0) {
+        if (kept != i) {
+          next[kept] = std::move(next[i]);
+        }
+        kept++;
+      }
+    }
+    next.erase(next.begin() + static_cast<std::ptrdiff_t>(kept), next.end());
+  }
+};
+
+} // namespace turing::simulator
@@ -0,0 +1,307 @@
+#pragma once
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+#include <Errors.h>
+#include <Machine.h>
+
+namespace turing::machine {
+
+// HotLayout orders a machine by the counts of a profile written by
+// --profile-json on an earlier run, so that what a run spends its steps on
+// sits together in the compiled tables. States are ordered by the steps
+// taken in them, and the transitions of every state by their hits, hottest
+// first. A transition only moves ahead of an earlier one of its state that
+// matches none of the symbols it matches, so the one that takes precedence
+// stays the same. Counts are matched by state name and transition text, and
+// those of states and transitions the machine does not have are ignored.
+struct HotLayout {
+private:
+  // The fields of one object of a profile. The strings are kept from
+  // object to object, only the first count are in use.
+  struct Object {
+    std::vector<std::pair<std::string, std::string>> fields;
+    Size count = 0;
+
+    auto has(std::string_view name) const -> bool {
+      return std::any_of(fields.begin(), fields.begin() + count,
+                         [name](const auto &field) {
+                           return field.first == name;
+                         });
+    }
+
+    auto get(std::string_view name) const -> std::string_view {
+      for (auto i = Size{0}; i < count; i++) {
+        if (fields[i].first == name) {
+          return fields[i].second;
+        }
+      }
+      return {};
+    }
+  };
+
+  std::unordered_map<State, std::uint64_t> stateSteps;
+  std::unordered_map<std::string, std::uint64_t> transitionHits;
+
+public:
+  static auto load(std::string_view json) -> utils::Result<HotLayout> {
+    auto layout = HotLayout{};
+    auto valid =
+        forEachObject(json, "states", [&layout](const Object &state) {
+          auto steps = utils::toNumber<std::uint64_t>(state.get("steps"));
+          if (!state.has("name") || !steps) {
+            return false;
+          }
+          if (*steps > 0) {
+            layout.stateSteps.emplace(state.get("name"), *steps);
+          }
+          return true;
+        }) &&
+        forEachObject(json, "transitions", [&layout](const Object &transition) {
+          auto hits = utils::toNumber<std::uint64_t>(transition.get("hits"));
+          if (!transition.has("transition") || !hits) {
+            return false;
+          }
+          // a duplicate line never fires, the first one has the hits
+          if (*hits > 0) {
+            layout.transitionHits.emplace(transition.get("transition"), *hits);
+          }
+          return true;
+        });
+    if (!valid) {
+      return utils::TuringError::ProfileInvalid;
+    }
+    return layout;
+  }
+
+  // Reorders the transitions of machine and returns its states, hottest
+  // first. A nondeterministic run takes every transition in declaration
+  // order, so then only the states move.
+  auto apply(TuringState &machine, bool nondeterministic) const
+      -> std::vector<State> {
+    auto ranked = std::vector<std::pair<std::uint64_t, const State *>>{};
+    ranked.reserve(machine.states.size());
+    for (const auto &state : machine.states) {
+      ranked.emplace_back(steps(state), &state);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.first > b.first;
+                     });
+
+    auto order = std::vector<State>{};
+    order.reserve(ranked.size());
+    auto rank = std::unordered_map<StateRef, Size>{};
+    for (const auto &entry : ranked) {
+      rank.emplace(*entry.second, order.size());
+      order.push_back(*entry.second);
+    }
+
+    // the transitions grouped by state, hottest state first, each group in
+    // declaration order until it is reordered
+    auto ranks = std::vector<Size>{};
+    ranks.reserve(machine.transitions.size());
+    for (const auto &transition : machine.transitions) {
+      ranks.push_back(rank.at(transition.currentState()));
+    }
+    auto grouped = std::vector<Size>(machine.transitions.size());
+    std::iota(grouped.begin(), grouped.end(), Size{0});
+    std::stable_sort(grouped.begin(), grouped.end(),
+                     [&ranks](Size a, Size b) { return ranks[a] < ranks[b]; });
+    for (auto first = grouped.begin(); first != grouped.end();) {
+      auto last = std::find_if(first, grouped.end(), [&](Size i) {
+        return ranks[i] != ranks[*first];
+      });
+      // no transition of a state without steps ever fired
+      if (!nondeterministic && ranked[ranks[*first]].first > 0) {
+        auto hottest = hottestFirst(machine, std::vector<Size>(first, last));
+        std::copy(hottest.begin(), hottest.end(), first);
+      }
+      first = last;
+    }
+
+    auto transitions = Transitions{};
+    transitions.reserve(machine.transitions.size());
+    for (auto i : grouped) {
+      transitions.insert(std::move(*(machine.transitions.begin() + i)));
+    }
+    machine.transitions = std::move(transitions);
+    return order;
+  }
+
+private:
+  auto steps(const State &state) const -> std::uint64_t {
+    auto it = stateSteps.find(state);
+    return it == stateSteps.end() ? 0 : it->second;
+  }
+
+  auto hits(const Transition &transition) const -> std::uint64_t {
+    auto it = transitionHits.find(transition.toString());
+    return it == transitionHits.end() ? 0 : it->second;
+  }
+
+  // The transitions of one state, most hits first as far as precedence
+  // allows: each one waits for the earlier ones it overlaps, and of those
+  // ready the one with the most hits, or else declared first, goes next.
+  auto hottestFirst(const TuringState &machine,
+                    const std::vector<Size> &declared) const
+      -> std::vector<Size> {
+    auto count = declared.size();
+    auto after = std::vector<std::vector<Size>>(count);
+    auto waiting = std::vector<Size>(count, 0);
+    auto wait = [&](Size earlier, Size later) {
+      after[earlier].push_back(later);
+      waiting[later]++;
+    };
+    // exact inputs only overlap the same input or a pattern
+    auto exact = std::unordered_map<SymbolsRef, Size>{};
+    for (auto i = Size{0}; i < count; i++) {
+      const auto &transition = machine.transitions[declared[i]];
+      if (!transition.isPattern()) {
+        auto [it, inserted] =
+            exact.try_emplace(transition.inputSymbols(), i);
+        if (!inserted) {
+          wait(it->second, i);
+          it->second = i;
+        }
+        continue;
+      }
+      for (auto j = Size{0}; j < count; j++) {
+        if (j != i &&
+            (j < i || !machine.transitions[declared[j]].isPattern()) &&
+            overlaps(machine, transition.inputSymbols(),
+                     machine.transitions[declared[j]].inputSymbols())) {
+          j < i ? wait(j, i) : wait(i, j);
+        }
+      }
+    }
+
+    auto counts = std::vector<std::uint64_t>(count);
+    for (auto i = Size{0}; i < count; i++) {
+      counts[i] = hits(machine.transitions[declared[i]]);
+    }
+    auto colder = [&counts](Size a, Size b) {
+      return counts[a] != counts[b] ? counts[a] < counts[b] : a > b;
+    };
+    auto ready = std::priority_queue<Size, std::vector<Size>,
+                                     decltype(colder)>(colder);
+    for (auto i = Size{0}; i < count; i++) {
+      if (waiting[i] == 0) {
+        ready.push(i);
+      }
+    }
+    auto ordered = std::vector<Size>{};
+    ordered.reserve(count);
+    while (!ready.empty()) {
+      auto i = ready.top();
+      ready.pop();
+      ordered.push_back(declared[i]);
+      for (auto later : after[i]) {
+        if (--waiting[later] == 0) {
+          ready.push(later);
+        }
+      }
+    }
+    return ordered;
+  }
+
+  // Whether some symbols under the heads match both inputs. A wildcard
+  // matches every non-blank symbol.
+  static auto overlaps(const TuringState &machine, SymbolsRef a, SymbolsRef b)
+      -> bool {
+    for (auto i = Size{0}; i < a.size(); i++) {
+      auto star = Transition::Wildcard;
+      if (a[i] != b[i] && (a[i] != star || b[i] == machine.blankSymbol) &&
+          (b[i] != star || a[i] == machine.blankSymbol)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Calls fn on every flat object of the array stored under key, until it
+  // returns false. Values are kept as their text, strings unquoted and
+  // numbers as written.
+  template <typename Fn>
+  static auto forEachObject(std::string_view json, std::string_view key, Fn fn)
+      -> bool {
+    auto start = json.find(utils::format("\"{}\":[", key));
+    if (start == std::string_view::npos) {
+      return false;
+    }
+    json.remove_prefix(start + key.size() + 4);
+    auto object = Object{};
+    while (!json.empty() && json.front() != ']') {
+      if (json.front() == ',') {
+        json.remove_prefix(1);
+      }
+      if (!parseObject(json, object) || !fn(object)) {
+        return false;
+      }
+    }
+    return !json.empty();
+  }
+
+  // {"key":value,...} at the front of json, which is advanced past it.
+  static auto parseObject(std::string_view &json, Object &object) -> bool {
+    if (json.empty() || json.front() != '{') {
+      return false;
+    }
+    json.remove_prefix(1);
+    object.count = 0;
+    while (!json.empty() && json.front() != '}') {
+      if (json.front() == ',') {
+        json.remove_prefix(1);
+      }
+      if (object.count == object.fields.size()) {
+        object.fields.emplace_back();
+      }
+      auto &[name, value] = object.fields[object.count++];
+      if (!parseString(json, name) || json.empty() || json.front() != ':') {
+        return false;
+      }
+      json.remove_prefix(1);
+      if (!json.empty() && json.front() == '"') {
+        if (!parseString(json, value)) {
+          return false;
+        }
+        continue;
+      }
+      auto end = json.find_first_of(",}");
+      if (end == std::string_view::npos) {
+        return false;
+      }
+      value.assign(json.substr(0, end));
+      json.remove_prefix(end);
+    }
+    if (json.empty()) {
+      return false;
+    }
+    json.remove_prefix(1);
+    return true;
+  }
+
+  // "text" at the front of json into text, undoing the escapes of
+  // Profile::quote.
+  static auto parseString(std::string_view &json, std::string &text) -> bool {
+    if (json.empty() || json.front() != '"') {
+      return false;
+    }
+    text.clear();
+    for (auto i = Size{1}; i < json.size(); i++) {
+      if (json[i] == '"') {
+        json.remove_prefix(i + 1);
+        return true;
+      }
+      if (json[i] == '\\' && ++i == json.size()) {
+        break;
+      }
+      text += json[i];
+    }
+    return false;
+  }
+};
+
+} // namespace turing::machine
@@ -1,5 +1,9 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 #include <StringUtils.h>
 
@@ -13,50 +17,224 @@ using concepts::StringConvertible;
 #define __turing_string_convertible__ StringConvertible
 #endif
 
+// Defining __turing_no_verbose__ compiles every verbose call out.
+#ifdef __turing_no_verbose__
+constexpr auto VerboseEnabled = false;
+#else
+constexpr auto VerboseEnabled = true;
+#endif
+
+// Writer takes full chunks of output off the logging thread and writes them
+// to a stream on its own thread. Chunks pass through a single-producer,
+// single-consumer ring: the logging thread only moves tail and the writer
+// only moves head, so neither side takes a lock. Written chunks go back to
+// the logging thread with their capacity, so steady logging allocates
+// nothing.
+struct Writer {
+private:
+  static constexpr auto Slots = std::size_t{16};
+
+  std::ostream &os;
+  std::array<std::string, Slots> chunks;
+  std::atomic<std::size_t> head = 0; // next chunk to write
+  std::atomic<std::size_t> tail = 0; // next free slot
+  std::atomic<bool> stopping = false;
+  std::thread thread;
+
+public:
+  explicit Writer(std::ostream &os) : os(os), thread([this] { drain(); }) {}
+
+  Writer(const Writer &) = delete;
+  auto operator=(const Writer &) -> Writer & = delete;
+
+  ~Writer() {
+    stopping = true;
+    auto empty = std::string{};
+    push(empty); // wakes the writer up
+    thread.join();
+  }
+
+  // Hands chunk over to the writer and leaves an emptied buffer in its place.
+  auto push(std::string &chunk) -> void {
+    auto last = tail.load(std::memory_order_relaxed);
+    for (auto first = head.load(std::memory_order_acquire);
+         last - first == Slots; first = head.load(std::memory_order_acquire)) {
+      wait(head, first);
+    }
+    chunks[last % Slots].swap(chunk);
+    chunk.clear();
+    tail.store(last + 1, std::memory_order_release);
+    wake(tail);
+  }
+
+  // Returns once every chunk pushed so far is written.
+  auto sync() -> void {
+    auto last = tail.load(std::memory_order_relaxed);
+    for (auto first = head.load(std::memory_order_acquire); first != last;
+         first = head.load(std::memory_order_acquire)) {
+      wait(head, first);
+    }
+  }
+
+private:
+  auto drain() -> void {
+    for (auto first = head.load(std::memory_order_relaxed);; first++) {
+      auto last = tail.load(std::memory_order_acquire);
+      while (first == last) {
+        if (stopping) {
+          return;
+        }
+        wait(tail, last);
+        last = tail.load(std::memory_order_acquire);
+      }
+      auto &chunk = chunks[first % Slots];
+      os.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+      chunk.clear();
+      head.store(first + 1, std::memory_order_release);
+      wake(head);
+    }
+  }
+
+  static auto wait(const std::atomic<std::size_t> &value, std::size_t old)
+      -> void {
+#ifdef __turing_legacy__
+    static_cast<void>(value);
+    static_cast<void>(old);
+    std::this_thread::yield();
+#else
+    value.wait(old, std::memory_order_acquire);
+#endif
+  }
+
+  static auto wake(std::atomic<std::size_t> &value) -> void {
+#ifndef __turing_legacy__
+    value.notify_one();
+#else
+    static_cast<void>(value);
+#endif
+  }
+};
+
+// Logger buffers its output and writes it out in large chunks, optionally
+// from a background Writer. Buffered output is flushed when an error is
+// logged, so that it comes before the error, and at exit. Messages are
+// formatted straight into the buffer. Logging is meant for one thread at a
+// time.
 struct Logger {
+public:
+  static constexpr auto ChunkSize = std::size_t{1} << 16;
+
 private:
   bool isVerbose;
   std::ostream &es;
   std::ostream &os;
+  mutable std::string buffer; // output not handed over yet
+  mutable std::unique_ptr<Writer> writer;
 
-  Logger() : isVerbose(false), es(std::cerr), os(std::cout) {}
+  Logger() : isVerbose(false), es(std::cerr), os(std::cout) {
+    buffer.reserve(ChunkSize);
+  }
 
 public:
-  enum struct Level { Info, Error };
+  // Notes are reports about the run rather than its output: they go to the
+  // error stream like errors, but do not mean anything failed.
+  enum struct Level { Info, Note, Error };
 
   static auto instance() -> Logger & {
     static Logger logger;
     return logger;
   }
 
-  auto setVerbose(bool verbose) -> void { isVerbose = verbose; }
+  Logger(const Logger &) = delete;
+  auto operator=(const Logger &) -> Logger & = delete;
+
+  ~Logger() { flush(); }
+
+  auto setVerbose(bool verbose) -> void {
+    isVerbose = VerboseEnabled && verbose;
+  }
+
+  // Writes full chunks from a background thread from now on.
+  auto startWriter() -> void {
+    if (!writer) {
+      writer = std::make_unique<Writer>(os);
+    }
+  }
+
+  // Writes out everything logged so far.
+  auto flush() const -> void {
+    if (writer) {
+      if (!buffer.empty()) {
+        writer->push(buffer);
+      }
+      writer->sync();
+    } else {
+      os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+    os.flush();
+  }
 
   auto log(Level level, std::string_view message) const -> void {
-    auto &stream = level == Level::Info ? os : es;
-    stream << message << std::endl;
+    write(level, [message](std::string &out) { out.append(message); });
   }
 
   auto info(std::string_view fmt,
             __turing_string_convertible__ auto &&...args) const -> void {
-    log(Level::Info, format(fmt, std::forward<decltype(args)>(args)...));
+    write(Level::Info, [&](std::string &out) {
+      formatTo(out, fmt, std::forward<decltype(args)>(args)...);
+    });
   }
 
   auto error(std::string_view fmt,
              __turing_string_convertible__ auto &&...args) const -> void {
-    log(Level::Error, format(fmt, std::forward<decltype(args)>(args)...));
+    write(Level::Error, [&](std::string &out) {
+      formatTo(out, fmt, std::forward<decltype(args)>(args)...);
+    });
   }
 
   auto verbose(Level level, std::string_view fmt,
                __turing_string_convertible__ auto &&...args) const -> void {
-    if (isVerbose) {
-      log(level, format(fmt, std::forward<decltype(args)>(args)...));
+    if constexpr (VerboseEnabled) {
+      if (isVerbose) {
+        write(level, [&](std::string &out) {
+          formatTo(out, fmt, std::forward<decltype(args)>(args)...);
+        });
+      }
     }
   }
 
   auto noVerbose(Level level, std::string_view fmt,
                  __turing_string_convertible__ auto &&...args) const -> void {
     if (!isVerbose) {
-      log(level, format(fmt, std::forward<decltype(args)>(args)...));
+      write(level, [&](std::string &out) {
+        formatTo(out, fmt, std::forward<decltype(args)>(args)...);
+      });
+    }
+  }
+
+private:
+  // Notes and errors go out at once, after everything logged before them.
+  template <typename Format>
+  auto write(Level level, Format &&format) const -> void {
+    if (level != Level::Info) {
+      flush();
+      auto message = std::string{};
+      format(message);
+      message += '\n';
+      es.write(message.data(), static_cast<std::streamsize>(message.size()));
+      es.flush();
+      return;
+    }
+    format(buffer);
+    buffer += '\n';
+    if (buffer.size() >= ChunkSize) {
+      if (writer) {
+        writer->push(buffer);
+      } else {
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+      }
     }
   }
 };
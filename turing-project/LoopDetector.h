@@ -0,0 +1,80 @@
+#pragma once
+#include <optional>
+
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// LoopDetector tells when a machine is back in a configuration it has been in
+// before: the same state, the same head positions and the same symbols on
+// every tape. Such a machine repeats itself forever. A machine that drifts,
+// coming back to the same configuration shifted along the tape, is not
+// caught, as positions are absolute.
+//
+// It follows Brent's algorithm, keeping a single saved configuration and
+// replacing it whenever the distance to it reaches the next power of two, so
+// memory stays bounded by one copy of the tapes. The first repeat it sees is
+// one period away from the saved configuration. Tapes are only compared when
+// the state and the configuration hash already match, which is O(1) once the
+// tapes track their hash.
+struct LoopDetector {
+private:
+  struct Configuration {
+    StateId state = 0;
+    Hash hash = 0;
+    std::vector<Position> heads;
+    std::vector<Position> firsts; // position of the first non-blank symbol
+    std::vector<Symbols> cells;   // from the first to the last non-blank
+
+    auto operator==(const Configuration &other) const -> bool = default;
+  };
+
+  Configuration saved;
+  Steps power = 1;
+  Steps distance = 0;
+
+public:
+  LoopDetector(StateId state, const Tapes &tapes) { reset(state, tapes); }
+
+  auto reset(StateId state, const Tapes &tapes) -> void {
+    save(state, tapes);
+    power = 1;
+    distance = 0;
+  }
+
+  // Called after every step, returns the period once the configuration
+  // repeats.
+  auto check(StateId state, const Tapes &tapes) -> std::optional<Steps> {
+    distance++;
+    if (state == saved.state && tapes.hash() == saved.hash &&
+        capture(state, tapes) == saved) {
+      return distance;
+    }
+    if (distance == power) {
+      save(state, tapes);
+      power *= 2;
+      distance = 0;
+    }
+    return std::nullopt;
+  }
+
+private:
+  static auto capture(StateId state, const Tapes &tapes) -> Configuration {
+    auto configuration = Configuration{state, tapes.hash(), {}, {}, {}};
+    for (const auto &tape : tapes) {
+      configuration.heads.push_back(tape.head());
+      configuration.firsts.push_back(tape.firstSymbol().value_or(0));
+      configuration.cells.push_back(tape.result());
+    }
+    return configuration;
+  }
+
+  auto save(StateId state, const Tapes &tapes) -> void {
+    saved = capture(state, tapes);
+  }
+};
+
+} // namespace turing::simulator
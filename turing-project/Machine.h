@@ -1,7 +1,6 @@
 #pragma once
-#include <map>
-#include <queue>
 #include <set>
+#include <span>
 
 #include <StringUtils.h>
 
@@ -12,7 +11,7 @@ using Position = int;
 
 enum class Move : Position { Left = -1, Right = 1, Stay = 0 };
 using Moves = std::vector<Move>;
-using MovesRef = const std::vector<Move> &;
+using MovesRef = std::span<const Move>;
 
 using State = std::string;
 using StateRef = std::string_view;
@@ -35,6 +34,10 @@ private:
   Moves moves;
 
 public:
+  // Matches any non-blank tape symbol when read, and keeps the symbol under
+  // the head when written in the same position as a read wildcard.
+  static constexpr Symbol Wildcard = '*';
+
   Transition(StateRef curr, SymbolsRef input, StateRef next, SymbolsRef output,
              Moves moves)
       : curr(curr), input(input), next(next), output(output),
@@ -52,13 +55,20 @@ public:
     return {{curr, input}, {next, output, moves}};
   }
 
+  auto currentState() const -> const State & { return curr; }
+  auto inputSymbols() const -> SymbolsRef { return input; }
+  auto nextState() const -> const State & { return next; }
+  auto outputSymbols() const -> SymbolsRef { return output; }
+  auto headMoves() const -> MovesRef { return moves; }
+
   auto isStarTransition() const -> bool {
-    return input.find('*') != std::string::npos ||
-           output.find('*') != std::string::npos;
+    return input.find(Wildcard) != std::string::npos ||
+           output.find(Wildcard) != std::string::npos;
   }
 
-  auto convertTransitions(const TuringState &state) const
-      -> std::set<Transition>;
+  auto isPattern() const -> bool {
+    return input.find(Wildcard) != std::string::npos;
+  }
 
   auto isValid(const TuringState &state) const -> bool;
 
@@ -67,43 +77,56 @@ public:
            std::tie(other.curr, other.input, other.next, other.output,
                     other.moves);
   }
+
+  auto toString() const -> std::string {
+    auto ret = curr + ' ' + input + ' ' + output + ' ';
+    for (auto move : moves) {
+      switch (move) {
+      case Move::Left:
+        ret += 'l';
+        break;
+      case Move::Right:
+        ret += 'r';
+        break;
+      case Move::Stay:
+        ret += '*';
+        break;
+      }
+    }
+    return ret + ' ' + next;
+  }
 };
 
+// Transitions keeps every line of the machine in declaration order, wildcard
+// patterns included. When several transitions match the same state and
+// symbols, the one declared first takes precedence.
 struct Transitions {
 public:
-  using TransitionMap =
-      std::map<Transition::StateInput, Transition::StateOutput>;
-  using iterator = TransitionMap::iterator;
-  using const_iterator = TransitionMap::const_iterator;
-  using value_type = TransitionMap::value_type;
+  using Container = std::vector<Transition>;
+  using iterator = Container::iterator;
+  using const_iterator = Container::const_iterator;
+  using value_type = Container::value_type;
 
 private:
-  TransitionMap transitions;
+  Container transitions;
 
 public:
   auto insert(Transition &&transition) -> void {
-    transitions.insert(std::move(transition).states());
+    transitions.emplace_back(std::move(transition));
   }
 
   auto insert(const Transition &transition) -> void {
-    transitions.insert(transition.states());
+    transitions.emplace_back(transition);
   }
 
-  auto erase(const Transition::StateInput &stateInput) -> void {
-    transitions.erase(stateInput);
-  }
+  auto reserve(Size count) -> void { transitions.reserve(count); }
 
-  auto get(const Transition::StateInput &stateInput) const
-      -> Transition::StateOutput {
-    return transitions.find(stateInput)->second;
-  }
+  auto size() const -> Size { return transitions.size(); }
 
-  auto contains(const Transition::StateInput &stateInput) const -> bool {
-    return transitions.contains(stateInput);
+  auto operator[](Size index) const -> const Transition & {
+    return transitions[index];
   }
 
-  auto size() const -> Size { return transitions.size(); }
-
   auto begin() -> iterator { return transitions.begin(); }
   auto begin() const -> const_iterator { return transitions.begin(); }
 
@@ -112,29 +135,9 @@ public:
 
   auto toString() const -> std::string {
     auto os = std::vector<std::string>{};
-    std::transform( //
-        transitions.begin(), transitions.end(), std::back_inserter(os),
-        [](const auto &v) {
-          auto ret = std::string{};
-          const auto &[in, out] = v;
-          const auto &[curr, input] = in;
-          const auto &[next, output, moves] = out;
-          ret += "    " + curr + ' ' + input + ' ' + next + ' ' + output + ' ';
-          for (auto move : moves) {
-            switch (move) {
-            case Move::Left:
-              ret += 'l';
-              break;
-            case Move::Right:
-              ret += 'r';
-              break;
-            case Move::Stay:
-              ret += '*';
-              break;
-            }
-          }
-          return ret;
-        });
+    std::transform(transitions.begin(), transitions.end(),
+                   std::back_inserter(os),
+                   [](const auto &v) { return "    " + v.toString(); });
     return utils::join(os, '\n');
   }
 };
@@ -174,54 +177,23 @@ struct TuringState {
                          transitions,              //
                          transitions.size());
   }
-};
 
-inline auto Transition::convertTransitions(const TuringState &state) const
-    -> std::set<Transition> {
-  auto queue = std::queue<Transition>();
-  auto result = std::set<Transition>();
-  queue.push(*this);
-  while (!queue.empty()) {
-    auto front = queue.front();
-    queue.pop();
-    auto flag = true;
-    for (auto i = 0; i < front.input.size(); i++) {
-      auto s1 = front.input[i];
-      auto s2 = front.output[i];
-      if (s1 == '*' || s2 == '*') {
-        flag = false;
-        auto nt = front;
-        if (s1 == '*' && s2 == '*') {
-          for (auto s : state.tapeSymbols) {
-            if (s != state.blankSymbol) {
-              nt.input[i] = s;
-              nt.output[i] = s;
-              queue.push(nt);
-            }
-          }
-        } else if (s1 == '*') {
-          for (auto s : state.tapeSymbols) {
-            if (s != state.blankSymbol) {
-              nt.input[i] = s;
-              queue.push(nt);
-            }
-          }
-        } else {
-          for (auto s : state.tapeSymbols) {
-            if (s != state.blankSymbol) {
-              nt.output[i] = s;
-              queue.push(nt);
-            }
-          }
-        }
-      }
-    }
-    if (flag) {
-      result.insert(front);
+  // The machine as a .tm file the parser reads back.
+  auto toSource() const -> std::string {
+    auto source = utils::format("#Q = {{}}\n#S = {{}}\n#G = {{}}\n#q0 = {}\n"
+                                "#B = {}\n#F = {{}}\n#N = {}\n",
+                                utils::join(states, ','),
+                                utils::join(symbols, ','),
+                                utils::join(tapeSymbols, ','), initialState,
+                                blankSymbol, utils::join(finalStates, ','),
+                                tapeCount);
+    for (const auto &transition : transitions) {
+      source += transition.toString();
+      source += '\n';
     }
+    return source;
   }
-  return result;
-}
+};
 
 inline auto Transition::isValid(const TuringState &state) const -> bool {
   if (!state.states.contains(curr) || !state.states.contains(next)) {
@@ -229,11 +201,11 @@ inline auto Transition::isValid(const TuringState &state) const -> bool {
   }
 
   for (auto i = 0; i < input.size(); i++) {
-    if (input[i] != '*' && !state.tapeSymbols.contains(input[i])) {
+    if (input[i] != Wildcard && !state.tapeSymbols.contains(input[i])) {
       return false;
     }
 
-    if (output[i] != '*' && !state.tapeSymbols.contains(output[i])) {
+    if (output[i] != Wildcard && !state.tapeSymbols.contains(output[i])) {
       return false;
     }
   }
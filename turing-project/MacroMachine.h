@@ -0,0 +1,304 @@
+#pragma once
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
+#include <Budget.h>
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// MacroMachine runs a single-tape Program on blocks of k cells. Every
+// (state, block, side the head entered from) triple is simulated once on the
+// base machine and memoized, and a run of identical blocks that a macro
+// transition crosses without changing state is applied in one operation.
+// Step counts stay exact. A block the head never leaves is simulated step by
+// step like on the plain interpreter, until the budget of the run is spent.
+struct MacroMachine {
+public:
+  using Block = std::uint64_t;
+
+  enum class Halt { Running, Accepted, Stopped };
+
+  static constexpr auto MaxBlockSize = Size{16};
+  static constexpr auto ProbeMacroSteps = Steps{1000};
+  // Base steps a probe may take, should a block keep the head in.
+  static constexpr auto ProbeSteps = Steps{1} << 20;
+
+private:
+  enum class Side : std::uint8_t { Left, Right };
+
+  struct MacroKey {
+    Block block;
+    StateId state;
+    Side side; // the side of the block the head stands on
+
+    auto operator==(const MacroKey &other) const -> bool = default;
+  };
+
+  struct MacroKeyHash {
+    auto operator()(const MacroKey &key) const -> Size {
+      auto hash = key.block * 0x9e3779b97f4a7c15;
+      hash ^= (Key{key.state} << 1 | static_cast<Key>(key.side)) +
+              0x632be59bd9b4e019 + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  struct MacroStep {
+    Halt halt;
+    StateId state;
+    Block block;
+    Side exit;   // side the head leaves through, while Running
+    Size offset; // cell the head halted on, otherwise
+    Steps steps; // base steps taken inside the block
+    bool paused; // the budget ran out inside the block, at offset
+  };
+
+  // A run of count equal blocks, stacked with the one nearest to the head
+  // on top.
+  struct Run {
+    Block block;
+    Steps count;
+  };
+
+  std::shared_ptr<const Program> program;
+  Size blockSize;
+  Size symbolBits;
+  Block cellMask;
+
+  std::unordered_map<MacroKey, MacroStep, MacroKeyHash> memo;
+
+  std::vector<Run> left;
+  std::vector<Run> right;
+  Block current = 0;
+  Side side = Side::Left;
+  StateId state;
+  Position block = 0; // index of the block under the head
+  Size offset = 0;    // cell under the head once halted
+  Steps step = 0;
+  Halt halt = Halt::Running;
+  bool paused = false; // stopped inside the block, at offset
+
+public:
+  MacroMachine(std::shared_ptr<const Program> program, Size blockSize)
+      : program(std::move(program)), blockSize(blockSize),
+        symbolBits(cellBits(*this->program)),
+        cellMask((Block{1} << symbolBits) - 1),
+        state(this->program->initialState()) {}
+
+  // Largest block size whose cells still fit in a Block.
+  static auto maxBlockSize(const Program &program) -> Size {
+    return std::min(MaxBlockSize, 64 / cellBits(program));
+  }
+
+  // Probes every block size for a few macro steps and keeps the one that
+  // covers the most base steps.
+  static auto chooseBlockSize(const std::shared_ptr<const Program> &program,
+                              SymbolsRef input) -> Size {
+    auto options = Options{};
+    options.maxSteps = ProbeSteps;
+    auto budget = Budget(options);
+    auto best = Size{1};
+    auto bestSteps = Steps{0};
+    for (auto size = Size{1}; size <= maxBlockSize(*program); size++) {
+      auto probe = MacroMachine(program, size);
+      probe.load(input);
+      probe.run(budget, ProbeMacroSteps);
+      if (probe.halted() || probe.steps() > bestSteps) {
+        best = size;
+        bestSteps = probe.steps();
+      }
+      if (probe.halted()) {
+        break;
+      }
+    }
+    return best;
+  }
+
+  auto load(SymbolsRef input) -> void {
+    left.clear();
+    right.clear();
+    memo.clear();
+    state = program->initialState();
+    block = 0;
+    offset = 0;
+    side = Side::Left;
+    step = 0;
+    halt = Halt::Running;
+    paused = false;
+
+    auto blocks = std::vector<Block>((input.size() + blockSize - 1) /
+                                     blockSize);
+    for (auto i = Size{0}; i < input.size(); i++) {
+      blocks[i / blockSize] |= Block{program->symbolId(input[i])}
+                               << (i % blockSize * symbolBits);
+    }
+    current = blocks.empty() ? 0 : blocks.front();
+    for (auto i = blocks.size(); i > 1; i--) {
+      push(right, blocks[i - 1], 1);
+    }
+  }
+
+  // Runs at most limit macro steps and tells whether the machine halted.
+  // Inside a block budget is checked as on the plain interpreter, and a run
+  // that exceeds it there stops for good.
+  auto run(const Budget &budget,
+           Steps limit = std::numeric_limits<Steps>::max()) -> Halt {
+    for (auto n = Steps{0};
+         n < limit && halt == Halt::Running && !paused; n++) {
+      auto macro = transition(state, current, side, budget);
+      if (macro.halt != Halt::Running || macro.paused) {
+        halt = macro.halt;
+        paused = macro.paused;
+        state = macro.state;
+        current = macro.block;
+        offset = macro.offset;
+        step += macro.steps;
+        continue;
+      }
+
+      auto &ahead = macro.exit == Side::Right ? right : left;
+      auto &behind = macro.exit == Side::Right ? left : right;
+      auto direction = macro.exit == Side::Right ? 1 : -1;
+      auto repeat = Steps{1};
+      // leaving through the far side in the same state means every equal
+      // block ahead goes through the very same macro transition
+      if (macro.state == state && macro.exit != side && !ahead.empty() &&
+          ahead.back().block == current) {
+        repeat += ahead.back().count;
+        ahead.pop_back();
+      }
+      push(behind, macro.block, repeat);
+      step += macro.steps * repeat;
+      block += direction * static_cast<Position>(repeat);
+      state = macro.state;
+      side = macro.exit == Side::Right ? Side::Left : Side::Right;
+      current = pop(ahead);
+    }
+    return halt;
+  }
+
+  auto halted() const -> bool { return halt != Halt::Running; }
+  auto steps() const -> Steps { return step; }
+  auto currentState() const -> StateId { return state; }
+
+  // Writes the configuration back to a regular tape.
+  auto store(Tape &tape) const -> void {
+    auto leftBlocks = Steps{0};
+    for (const auto &run : left) {
+      leftBlocks += run.count;
+    }
+    auto cells = Symbols{};
+    for (const auto &run : left) {
+      append(cells, run);
+    }
+    auto head = static_cast<Position>(cells.size());
+    append(cells, Run{current, 1});
+    for (auto i = right.size(); i > 0; i--) {
+      append(cells, right[i - 1]);
+    }
+    auto headOffset = halted() || paused ? offset
+                      : side == Side::Left ? Size{0}
+                                           : blockSize - 1;
+    auto start = (block - static_cast<Position>(leftBlocks)) *
+                 static_cast<Position>(blockSize);
+    tape.load(cells, start, start + head + static_cast<Position>(headOffset));
+  }
+
+private:
+  static auto cellBits(const Program &program) -> Size {
+    return std::max<Size>(std::bit_width(program.symbols() - 1), 1);
+  }
+
+  auto cell(Block cells, Size index) const -> SymbolId {
+    return static_cast<SymbolId>((cells >> (index * symbolBits)) & cellMask);
+  }
+
+  auto append(Symbols &cells, const Run &run) const -> void {
+    for (auto n = Steps{0}; n < run.count; n++) {
+      for (auto i = Size{0}; i < blockSize; i++) {
+        cells.push_back(program->symbol(cell(run.block, i)));
+      }
+    }
+  }
+
+  static auto push(std::vector<Run> &stack, Block block, Steps count)
+      -> void {
+    if (!stack.empty() && stack.back().block == block) {
+      stack.back().count += count;
+    } else {
+      stack.push_back({block, count});
+    }
+  }
+
+  // Blocks past the written ones are blank, which is block 0.
+  static auto pop(std::vector<Run> &stack) -> Block {
+    if (stack.empty()) {
+      return 0;
+    }
+    auto block = stack.back().block;
+    if (--stack.back().count == 0) {
+      stack.pop_back();
+    }
+    return block;
+  }
+
+  // The memoized macro step, simulated on a miss. A simulation cut short by
+  // the budget depends on the steps taken before it, so it is not kept.
+  auto transition(StateId from, Block cells, Side entry, const Budget &budget)
+      -> MacroStep {
+    auto key = MacroKey{cells, from, entry};
+    if (auto it = memo.find(key); it != memo.end()) {
+      return it->second;
+    }
+    auto macro = simulate(from, cells, entry, budget);
+    if (!macro.paused) {
+      memo.emplace(key, macro);
+    }
+    return macro;
+  }
+
+  // Runs the base machine inside one block until it leaves, halts or runs
+  // out of budget, which is checked at its checkpoints as the plain
+  // interpreter does, counting the steps taken so far.
+  auto simulate(StateId from, Block cells, Side entry,
+                const Budget &budget) const -> MacroStep {
+    auto pos = static_cast<Position>(entry == Side::Left ? 0 : blockSize - 1);
+    auto q = from;
+    auto checkpoint = budget.checkpoint(step);
+    for (auto steps = Steps{0};; steps++) {
+      auto at = static_cast<Size>(pos);
+      if (program->accepts(q)) {
+        return {Halt::Accepted, q, cells, entry, at, steps, false};
+      }
+      auto action = program->find(q, Key{cell(cells, at)});
+      if (action == Program::NoAction) {
+        return {Halt::Stopped, q, cells, entry, at, steps, false};
+      }
+      if (step + steps >= checkpoint) {
+        if (budget.exceeded(step + steps)) {
+          return {Halt::Running, q, cells, entry, at, steps, true};
+        }
+        checkpoint = budget.checkpoint(step + steps);
+      }
+      auto output = program->output(action)[0];
+      if (output != Transition::Wildcard) {
+        auto shift = at * symbolBits;
+        cells = (cells & ~(cellMask << shift)) |
+                Block{program->symbolId(output)} << shift;
+      }
+      q = program->next(action);
+      pos += static_cast<Position>(program->move(action)[0]);
+      if (pos < 0 || pos >= static_cast<Position>(blockSize)) {
+        auto exit = pos < 0 ? Side::Left : Side::Right;
+        return {Halt::Running, q, cells, exit, 0, steps + 1, false};
+      }
+    }
+  }
+};
+
+} // namespace turing::simulator
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define __turing_mmap__
+#else
+#include <fstream>
+#endif
+
+namespace turing::utils {
+
+// MappedFile maps a whole file read-only into memory. Pages are read when
+// they are first touched, so opening even a large file is cheap. Platforms
+// without mmap read the file into a buffer instead, as do bytes that are
+// already in memory.
+struct MappedFile {
+private:
+  const std::byte *data = nullptr;
+  std::size_t size = 0;
+  std::vector<std::byte> buffer; // the bytes unless mapped
+
+  MappedFile() = default;
+
+public:
+  static auto open(const std::string &path) -> std::optional<MappedFile> {
+    auto file = MappedFile{};
+#ifdef __turing_mmap__
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return std::nullopt;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+    file.size = static_cast<std::size_t>(info.st_size);
+    if (file.size > 0) {
+      auto *address = ::mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address == MAP_FAILED) {
+        ::close(fd);
+        return std::nullopt;
+      }
+      file.data = static_cast<const std::byte *>(address);
+    }
+    ::close(fd);
+#else
+    auto fs = std::ifstream(path, std::ios::binary);
+    if (!fs.is_open()) {
+      return std::nullopt;
+    }
+    fs.seekg(0, std::ios::end);
+    file.buffer.resize(static_cast<std::size_t>(fs.tellg()));
+    fs.seekg(0, std::ios::beg);
+    fs.read(reinterpret_cast<char *>(file.buffer.data()),
+            static_cast<std::streamsize>(file.buffer.size()));
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+#endif
+    return file;
+  }
+
+  // Holds a copy of bytes, as if read from a file.
+  static auto copy(std::span<const std::byte> bytes) -> MappedFile {
+    auto file = MappedFile{};
+    file.buffer.assign(bytes.begin(), bytes.end());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return file;
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : data(std::exchange(other.data, nullptr)),
+        size(std::exchange(other.size, 0)), buffer(std::move(other.buffer)) {}
+
+  auto operator=(MappedFile &&other) noexcept -> MappedFile & {
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(buffer, other.buffer);
+    return *this;
+  }
+
+  ~MappedFile() {
+#ifdef __turing_mmap__
+    if (data != nullptr && buffer.empty()) {
+      ::munmap(const_cast<std::byte *>(data), size);
+    }
+#endif
+  }
+
+  auto bytes() const -> std::span<const std::byte> { return {data, size}; }
+};
+
+} // namespace turing::utils
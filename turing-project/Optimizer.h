@@ -0,0 +1,305 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include <Machine.h>
+
+namespace turing::machine {
+
+namespace constants {
+
+constexpr auto OptimizeReportFormat =
+    "==================== OPTIMIZE ====================\n"
+    "States      : {} -> {}\n"
+    "Transitions : {} -> {}\n"
+    "Unreachable : {} states, {} transitions\n"
+    "Never fire  : {} transitions\n"
+    "Merged      : {} states\n"
+    "==================== END ====================";
+
+} // namespace constants
+
+// Optimizer shrinks a machine without changing what any run of it prints
+// but the names of merged states. It drops
+// - transitions that can never fire: those leaving a final state, where a
+//   run stops at once, those whose every match is taken by earlier
+//   transitions of the same state, which take precedence, and wildcards of
+//   a machine without non-blank tape symbols,
+// - states the initial state cannot reach, with their transitions,
+// - states equivalent to another, found by partition refinement: states
+//   start split into final and other ones, and a class is split again as
+//   long as its states differ in their transitions, taken in order with the
+//   next state replaced by its class. Every class is kept as one state, the
+//   initial state or else the first in name order.
+//
+// A nondeterministic run takes shadowed transitions too, so they are kept.
+struct Optimizer {
+public:
+  // Patterns standing for more combinations of symbols are only checked
+  // against single earlier transitions.
+  static constexpr auto MaxCombinations = Size{4096};
+
+  struct Report {
+    Size statesBefore = 0;
+    Size transitionsBefore = 0;
+    Size unreachableStates = 0;
+    Size unreachableTransitions = 0;
+    Size deadTransitions = 0;
+    Size mergedStates = 0;
+    Size statesAfter = 0;
+    Size transitionsAfter = 0;
+
+    auto toString() const -> std::string {
+      return utils::format(constants::OptimizeReportFormat, statesBefore,
+                           statesAfter, transitionsBefore, transitionsAfter,
+                           unreachableStates, unreachableTransitions,
+                           deadTransitions, mergedStates);
+    }
+  };
+
+private:
+  // What a transition does, with its next state replaced by a class.
+  using Behaviour = std::tuple<Symbols, Symbols, Moves, Size>;
+  using Signature = std::pair<Size, std::vector<Behaviour>>;
+
+  TuringState &machine;
+  bool nondeterministic;
+
+  std::vector<State> names;
+  std::unordered_map<StateRef, Size> ids;
+  std::vector<std::vector<Size>> outgoing; // per state, live transitions
+  std::vector<Size> from;                  // per transition
+  std::vector<Size> to;                    // per transition
+  Symbols starSymbols;                     // matched by a wildcard
+
+public:
+  Optimizer(TuringState &machine, bool nondeterministic)
+      : machine(machine), nondeterministic(nondeterministic),
+        names(machine.states.begin(), machine.states.end()),
+        outgoing(names.size()) {
+    for (auto state = Size{0}; state < names.size(); state++) {
+      ids.emplace(names[state], state);
+    }
+    for (auto symbol : machine.tapeSymbols) {
+      if (symbol != machine.blankSymbol) {
+        starSymbols += symbol;
+      }
+    }
+    for (const auto &transition : machine.transitions) {
+      from.push_back(ids.at(transition.currentState()));
+      to.push_back(ids.at(transition.nextState()));
+    }
+  }
+
+  // Rewrites the machine in place.
+  auto optimize() -> Report {
+    auto report = Report{};
+    report.statesBefore = names.size();
+    report.transitionsBefore = machine.transitions.size();
+
+    report.deadTransitions = findLive();
+    auto reachable = findReachable();
+    for (auto state = Size{0}; state < names.size(); state++) {
+      if (!reachable[state]) {
+        report.unreachableStates++;
+        report.unreachableTransitions += outgoing[state].size();
+        outgoing[state].clear();
+      }
+    }
+
+    auto classes = refine(reachable);
+    auto representative = std::vector<Size>(names.size(), names.size());
+    auto initial = ids.at(machine.initialState);
+    representative[classes[initial]] = initial;
+    for (auto state = Size{0}; state < names.size(); state++) {
+      if (reachable[state] && representative[classes[state]] == names.size()) {
+        representative[classes[state]] = state;
+      }
+    }
+
+    auto kept = std::vector<bool>(names.size(), false);
+    for (auto state = Size{0}; state < names.size(); state++) {
+      if (reachable[state]) {
+        kept[representative[classes[state]]] = true;
+        if (representative[classes[state]] != state) {
+          report.mergedStates++;
+        }
+      }
+    }
+    rebuild(kept,
+            [&](Size state) { return representative[classes[state]]; });
+
+    report.statesAfter = machine.states.size();
+    report.transitionsAfter = machine.transitions.size();
+    return report;
+  }
+
+private:
+  // Fills outgoing with the transitions that can fire and counts the others.
+  auto findLive() -> Size {
+    auto accepting = std::vector<bool>(names.size(), false);
+    for (const auto &name : machine.finalStates) {
+      accepting[ids.at(name)] = true;
+    }
+
+    auto dead = Size{0};
+    for (auto i = Size{0}; i < machine.transitions.size(); i++) {
+      const auto &transition = machine.transitions[i];
+      auto &live = outgoing[from[i]];
+      auto shadowed = !nondeterministic && isShadowed(transition, live);
+      if (accepting[from[i]] || shadowed ||
+          (starSymbols.empty() && transition.isStarTransition())) {
+        dead++;
+        continue;
+      }
+      live.push_back(i);
+    }
+    return dead;
+  }
+
+  // Whether the earlier transitions match everything transition does. A
+  // pattern is checked one combination of symbols at a time, as long as it
+  // does not stand for more than MaxCombinations of them.
+  auto isShadowed(const Transition &transition,
+                  const std::vector<Size> &earlier) const -> bool {
+    auto input = transition.inputSymbols();
+    auto matchedBy = [&](SymbolsRef symbols) {
+      return std::any_of(earlier.begin(), earlier.end(), [&](Size other) {
+        return covers(machine.transitions[other].inputSymbols(), symbols);
+      });
+    };
+    if (matchedBy(input)) {
+      return true;
+    }
+    auto wildcards = static_cast<Size>(
+        std::count(input.begin(), input.end(), Transition::Wildcard));
+    auto combinations = Size{1};
+    for (auto i = Size{0}; i < wildcards; i++) {
+      combinations *= starSymbols.size();
+      if (combinations > MaxCombinations) {
+        return false;
+      }
+    }
+    auto symbols = Symbols{input};
+    for (auto combination = Size{0}; combination < combinations;
+         combination++) {
+      for (auto i = Size{0}, rest = combination; i < input.size(); i++) {
+        if (input[i] == Transition::Wildcard) {
+          symbols[i] = starSymbols[rest % starSymbols.size()];
+          rest /= starSymbols.size();
+        }
+      }
+      if (!matchedBy(symbols)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Whether every symbols matched by input are matched by earlier as well.
+  auto covers(SymbolsRef earlier, SymbolsRef input) const -> bool {
+    for (auto i = Size{0}; i < input.size(); i++) {
+      if (earlier[i] != input[i] &&
+          (earlier[i] != Transition::Wildcard ||
+           input[i] == machine.blankSymbol)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto findReachable() const -> std::vector<bool> {
+    auto reachable = std::vector<bool>(names.size(), false);
+    auto pending = std::vector<Size>{ids.at(machine.initialState)};
+    reachable[pending.front()] = true;
+    while (!pending.empty()) {
+      auto state = pending.back();
+      pending.pop_back();
+      for (auto i : outgoing[state]) {
+        if (!reachable[to[i]]) {
+          reachable[to[i]] = true;
+          pending.push_back(to[i]);
+        }
+      }
+    }
+    return reachable;
+  }
+
+  // The class of every reachable state, once no class splits any further.
+  // A round only ever splits classes, so it is done when their number stays
+  // the same.
+  auto refine(const std::vector<bool> &reachable) const -> std::vector<Size> {
+    auto classes = std::vector<Size>(names.size(), 0);
+    auto count = Size{0};
+    {
+      auto accepting = std::map<bool, Size>{};
+      for (auto state = Size{0}; state < names.size(); state++) {
+        if (reachable[state]) {
+          auto [it, inserted] = accepting.try_emplace(
+              machine.finalStates.contains(names[state]), accepting.size());
+          classes[state] = it->second;
+        }
+      }
+      count = accepting.size();
+    }
+    while (true) {
+      auto signatures = std::map<Signature, Size>{};
+      auto next = std::vector<Size>(names.size(), 0);
+      for (auto state = Size{0}; state < names.size(); state++) {
+        if (!reachable[state]) {
+          continue;
+        }
+        auto signature = Signature{classes[state], {}};
+        for (auto i : outgoing[state]) {
+          const auto &transition = machine.transitions[i];
+          auto moves = transition.headMoves();
+          signature.second.emplace_back(Symbols{transition.inputSymbols()},
+                                        Symbols{transition.outputSymbols()},
+                                        Moves{moves.begin(), moves.end()},
+                                        classes[to[i]]);
+        }
+        auto [it, inserted] =
+            signatures.try_emplace(std::move(signature), signatures.size());
+        next[state] = it->second;
+      }
+      classes = std::move(next);
+      if (signatures.size() == count) {
+        return classes;
+      }
+      count = signatures.size();
+    }
+  }
+
+  template <typename Representative>
+  auto rebuild(const std::vector<bool> &kept, Representative representative)
+      -> void {
+    auto transitions = Transitions{};
+    for (auto state = Size{0}; state < names.size(); state++) {
+      if (!kept[state]) {
+        machine.states.erase(names[state]);
+        machine.finalStates.erase(names[state]);
+      }
+    }
+    auto live = std::vector<bool>(machine.transitions.size(), false);
+    for (auto state = Size{0}; state < names.size(); state++) {
+      for (auto i : outgoing[state]) {
+        live[i] = kept[state];
+      }
+    }
+    for (auto i = Size{0}; i < machine.transitions.size(); i++) {
+      if (!live[i]) {
+        continue;
+      }
+      const auto &transition = machine.transitions[i];
+      auto moves = transition.headMoves();
+      transitions.insert(Transition(
+          transition.currentState(), transition.inputSymbols(),
+          names[representative(to[i])], transition.outputSymbols(),
+          Moves{moves.begin(), moves.end()}));
+    }
+    machine.transitions = std::move(transitions);
+  }
+};
+
+} // namespace turing::machine
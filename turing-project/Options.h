@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace turing::simulator {
+
+enum class Engine {
+  Table,            // steps the compiled transition table one cell at a time
+  Macro,            // memoized block transitions, single-tape machines only
+  Threaded,         // per-state records linked to their successors
+  Nondeterministic, // every matching transition, explored breadth-first
+};
+
+// Knobs of a single run, as selected on the command line.
+struct Options {
+  bool sweep = false; // apply self-looping runs over equal cells in one step
+  Engine engine = Engine::Table;
+  std::size_t blockSize = 0; // macro engine block size, 0 picks one
+
+  std::uint64_t maxSteps = 0; // give up after this many steps, 0 never does
+  double timeout = 0;         // give up after this many seconds, 0 never does
+  bool detectLoops = false;   // stop once a configuration repeats
+
+  std::string_view trace; // record every step in this trace file
+
+  std::string_view checkpoint; // save the run here every checkpointEvery
+  double checkpointEvery = 60;  // seconds between checkpoints
+  std::string_view resume;      // continue the run saved in this checkpoint
+
+  bool profile = false;        // count the steps spent in every state
+  std::string_view profileJson; // also write the counts here as JSON
+
+  bool debug = false;     // step the run on commands read from stdin
+  bool showTrace = false; // print a recorded trace instead of running
+  std::uint64_t traceFrom = 0;               // first step printed
+  std::uint64_t traceTo = ~std::uint64_t{0}; // last step printed
+
+  std::string_view batch;  // file with one input per line, "-" for stdin
+  std::size_t jobs = 0;    // batch and ntm worker threads, 0 uses every core
+
+  std::string_view compile; // write the compiled image here instead of running
+
+  bool optimize = false;          // drop dead parts and merge equal states
+  std::string_view dumpOptimized; // write the optimized source here instead
+  std::string_view layoutProfile; // lay out the tables by this profile
+
+  bool emitCpp = false;    // print the machine as a C++ program instead
+  std::string_view native; // build that program into this executable
+};
+
+} // namespace turing::simulator
@@ -1,10 +1,14 @@
 #pragma once
-#include <fstream>
-#include <regex>
+#include <array>
+#include <charconv>
+#include <unordered_set>
 
 #include <Errors.h>
+#include <HotLayout.h>
 #include <Logger.h>
 #include <Machine.h>
+#include <MappedFile.h>
+#include <Optimizer.h>
 #include <Simulator.h>
 
 namespace turing::parser {
@@ -13,40 +17,75 @@ namespace constants {
 
 using namespace std::literals::string_view_literals;
 
-constexpr auto Usage = "usage: turing [-v|--verbose] [-h|--help] <tm> <input>";
-constexpr auto EmptyString = ""sv;
+constexpr auto SourceExtension = ".tm"sv;
+constexpr auto ImageExtension = ".tmc"sv;
 
-constexpr auto StatesFlag = "#Q";
-constexpr auto SymbolsFlags = "#S";
-constexpr auto TapeSymbolsFlags = "#G";
-constexpr auto InitialStateFlags = "#q0";
-constexpr auto BlankSymbolFlag = "#B";
-constexpr auto FinalStatesFlag = "#F";
-constexpr auto TapeCountFlag = "#N";
+constexpr auto StatesFlag = "#Q"sv;
+constexpr auto SymbolsFlags = "#S"sv;
+constexpr auto TapeSymbolsFlags = "#G"sv;
+constexpr auto InitialStateFlags = "#q0"sv;
+constexpr auto BlankSymbolFlag = "#B"sv;
+constexpr auto FinalStatesFlag = "#F"sv;
+constexpr auto TapeCountFlag = "#N"sv;
 constexpr auto CommentFlag = ';';
 
 constexpr auto InvalidSymbols = " ,;{}*_"sv;
 constexpr auto InvalidTapeSymbols = " ,;{}*"sv;
+constexpr auto Whitespace = " \t\n\v\f\r"sv;
+
+constexpr auto SyntaxErrorFormat =
+    "==================== ERR ====================\n"
+    "error: {} at line {}, column {}\n"
+    "{}\n"
+    "{}^\n"
+    "==================== END ====================";
 
 } // namespace constants
 
 using machine::Move;
+using machine::Program;
+using machine::Size;
 using machine::Moves;
 using machine::Transition;
 using machine::TuringState;
+using simulator::Engine;
+using simulator::Options;
 using simulator::Simulator;
 using utils::Error;
 using utils::Logger;
 using utils::Result;
 using utils::TuringError;
 
+// Parser reads a .tm file in a single pass over its mapped bytes. Lines and
+// fields are string_views into the file; only the names and symbols kept in
+// the TuringState are copied. No error ends the process: every one is
+// returned, so that a program can run machines of its own in-process.
+//
+// Each definition follows the grammar
+//
+//   #Q = {names}    #S = {symbols}    #G = {symbols}    #F = {names}
+//   #q0 = name      #B = _            #N = digits
+//   state input output moves next
+//
+// where blanks of any kind may surround '=', spaces inside braces are
+// ignored, and the fields of a transition are separated by spaces.
 struct Parser {
 private:
-  std::ifstream fs;
+  utils::MappedFile file;
+  bool isImage; // file holds a compiled image rather than a source
   TuringState turingState;
+  std::vector<machine::State> stateOrder; // hottest first, from a profile
 
   const Logger &logger;
   std::string_view input;
+  Options options;
+
+  // declared names, looked up once per transition
+  std::unordered_set<std::string_view> declaredStates;
+  std::array<bool, 256> declaredTapeSymbols{};
+
+  const char *errorAt = nullptr; // where the last syntax error was found
+  std::string scratch;           // a list item with its spaces removed
 
   static auto trimComments(std::string_view line) -> std::string_view {
     auto commentPos = line.find(constants::CommentFlag);
@@ -56,242 +95,344 @@ private:
     return line;
   }
 
+  static auto openFile(const std::string &filename)
+      -> Result<utils::MappedFile> {
+    auto file = utils::MappedFile::open(filename);
+    if (!file) {
+      Logger::instance().error("failed to open file: {}", filename);
+      return TuringError::FileUnreadable;
+    }
+    return std::move(*file);
+  }
+
+  Parser(utils::MappedFile file, bool isImage, std::string_view input,
+         Options options)
+      : file(std::move(file)), isImage(isImage), logger(Logger::instance()),
+        input(input), options(options) {}
+
 public:
-  explicit Parser(std::string_view filename, std::string_view input)
-      : fs(filename.data()), logger(Logger::instance()), input(input) {
-    if (!fs.is_open()) {
-      logger.error("failed to open file: {}", filename);
-      std::exit(1);
+  // Maps the machine in filename, a compiled image if it ends in .tmc and a
+  // source otherwise. input and the paths of options must outlive the
+  // parser.
+  static auto open(std::string_view filename, std::string_view input,
+                   Options options = {}) -> Result<Parser> {
+    auto file = openFile(std::string{filename});
+    if (!file) {
+      return file.error();
     }
+    auto image = filename.ends_with(constants::ImageExtension);
+    return Parser(std::move(*file), image, input, options);
   }
 
-  static Parser fromArgs(int argc, char **argv) {
-    auto &logger = Logger::instance();
-    if (argc < 2) {
-      logger.info(constants::Usage);
-      std::exit(1);
-    }
-
-    auto args = std::vector<std::string_view>(argv + 1, argv + argc);
-    auto filename = constants::EmptyString;
-    auto input = constants::EmptyString;
-    auto doHelp = false;
-    auto doVerbose = false;
-    for (auto arg : args) {
-      if (!doVerbose && (arg == "-v" || arg == "--verbose")) {
-        doVerbose = true;
-      } else if (!doHelp && (arg == "-h" || arg == "--help")) {
-        doHelp = true;
-      } else if (filename.empty()) {
-        filename = arg;
-      } else if (input.empty()) {
-        input = arg;
+  // Reads the machine from a copy of source, the text of a .tm file.
+  static auto fromSource(std::string_view source, std::string_view input = {},
+                         Options options = {}) -> Parser {
+    return Parser(utils::MappedFile::copy(std::as_bytes(std::span{source})),
+                  false, input, options);
+  }
+
+  // Reads the machine from a copy of image, the bytes of a .tmc file.
+  static auto fromImage(std::span<const std::byte> image,
+                        std::string_view input = {}, Options options = {})
+      -> Parser {
+    return Parser(utils::MappedFile::copy(image), true, input, options);
+  }
+
+  auto parse() -> Result<Simulator> {
+    auto compiled = program();
+    if (!compiled) {
+      return compiled.error();
+    }
+    if (options.engine == Engine::Nondeterministic) {
+      auto simulator = Simulator::of(std::move(*compiled), input, options);
+      if (!simulator) {
+        return simulator.error();
+      }
+      if (auto explored = (*simulator).explore(turingState); !explored) {
+        return explored.error();
       }
+      return simulator;
+    }
+    if (options.resume.empty()) {
+      return Simulator::of(std::move(*compiled), input, options);
     }
 
-    logger.setVerbose(doVerbose);
-    if (doHelp) {
-      logger.info(constants::Usage);
-      std::exit(0);
+    // the checkpoint brings its own input
+    auto resumed = openFile(std::string{options.resume});
+    if (!resumed) {
+      return resumed.error();
     }
+    auto checkpoint = simulator::Checkpoint::load(std::move(*resumed));
+    if (!checkpoint) {
+      return checkpoint.error();
+    }
+    auto simulator =
+        Simulator::of(std::move(*compiled), (*checkpoint).input(), options);
+    if (!simulator) {
+      return simulator.error();
+    }
+    if (auto restored = (*simulator).restore(*checkpoint); !restored) {
+      return restored.error();
+    }
+    return simulator;
+  }
 
-    if (!filename.ends_with(".tm")) {
-      logger.error("No input file specified");
-      std::exit(1);
+  // Compiles the machine, or maps it as is from a compiled image.
+  auto program() -> Result<std::shared_ptr<const Program>> {
+    if (isImage) {
+      if (options.optimize || !options.layoutProfile.empty()) {
+        // the image no longer holds the transitions to rearrange
+        return TuringError::ImageUnsupportedMachine;
+      }
+      auto loaded = Program::load(std::move(file));
+      if (!loaded) {
+        return loaded.error();
+      }
+      return std::make_shared<const Program>(std::move(*loaded));
+    }
+    if (auto e = parseMachine(); e != TuringError::Ok) {
+      return e;
     }
+    return std::make_shared<const Program>(
+        Program::compile(turingState, stateOrder));
+  }
 
-    return Parser(filename, input);
+  // Reads the file as a recorded trace.
+  auto trace() -> Result<simulator::Trace> {
+    return simulator::Trace::load(std::move(file));
   }
 
-  auto parse() -> Result<Simulator> {
-    while (!fs.eof()) {
-      auto rLine = std::string{};
-      std::getline(fs, rLine, '\n');
-      auto line = trimComments(rLine);
-      line = utils::trim(line);
-      if (line.empty()) {
-        continue;
-      }
+  // Reads the machine from its source, which an image no longer holds.
+  auto parseSource() -> Error {
+    if (isImage) {
+      return TuringError::ImageUnsupportedMachine;
+    }
+    return parseMachine();
+  }
 
-      Error e;
-      if (line.starts_with(constants::StatesFlag)) {
-        e = parseStates(line);
-      } else if (line.starts_with(constants::SymbolsFlags)) {
-        e = parseSymbols(line);
-      } else if (line.starts_with(constants::TapeSymbolsFlags)) {
-        e = parseTapeSymbols(line);
-      } else if (line.starts_with(constants::InitialStateFlags)) {
-        e = parseInitialState(line);
-      } else if (line.starts_with(constants::BlankSymbolFlag)) {
-        e = parseBlankSymbol(line);
-      } else if (line.starts_with(constants::FinalStatesFlag)) {
-        e = parseFinalStates(line);
-      } else if (line.starts_with(constants::TapeCountFlag)) {
-        e = parseTapeCount(line);
-      } else {
-        e = parseTransitions(line);
-      }
-      if (e != TuringError::Ok) {
+  // Reads the machine alone, for runs that bring their own inputs.
+  auto parseMachine() -> Error {
+    auto bytes = file.bytes();
+    auto text = std::string_view{reinterpret_cast<const char *>(bytes.data()),
+                                 bytes.size()};
+    // most lines of a large machine are transitions
+    turingState.transitions.reserve(
+        static_cast<Size>(std::count(text.begin(), text.end(), '\n')));
+    for (auto lineNumber = Size{1}; !text.empty(); lineNumber++) {
+      auto end = text.find('\n');
+      auto rLine = text.substr(0, end);
+      text.remove_prefix(end == std::string_view::npos ? text.size()
+                                                       : end + 1);
+      if (auto e = parseLine(rLine); e != TuringError::Ok) {
+        reportError(e, rLine, lineNumber);
         return e;
       }
     }
+    if (options.optimize) {
+      // on stderr, so that results and emitted programs stay as they are
+      auto optimizer = machine::Optimizer(
+          turingState, options.engine == Engine::Nondeterministic);
+      logger.log(Logger::Level::Note, optimizer.optimize().toString());
+    }
+    if (!options.layoutProfile.empty()) {
+      auto profile = openFile(std::string{options.layoutProfile});
+      if (!profile) {
+        return profile.error();
+      }
+      auto bytes = (*profile).bytes();
+      auto layout = machine::HotLayout::load(
+          {reinterpret_cast<const char *>(bytes.data()), bytes.size()});
+      if (!layout) {
+        return layout.error();
+      }
+      stateOrder = (*layout).apply(
+          turingState, options.engine == Engine::Nondeterministic);
+    }
+    return TuringError::Ok;
+  }
+
+  auto parseLine(std::string_view rLine) -> Error {
+    auto line = trimComments(rLine);
+    line = utils::trim(line);
+    if (line.empty()) {
+      return TuringError::Ok;
+    }
 
-    return Simulator::of(std::move(turingState), input);
+    if (line.starts_with(constants::StatesFlag)) {
+      return parseStates(line);
+    }
+    if (line.starts_with(constants::SymbolsFlags)) {
+      return parseSymbols(line);
+    }
+    if (line.starts_with(constants::TapeSymbolsFlags)) {
+      return parseTapeSymbols(line);
+    }
+    if (line.starts_with(constants::InitialStateFlags)) {
+      return parseInitialState(line);
+    }
+    if (line.starts_with(constants::BlankSymbolFlag)) {
+      return parseBlankSymbol(line);
+    }
+    if (line.starts_with(constants::FinalStatesFlag)) {
+      return parseFinalStates(line);
+    }
+    if (line.starts_with(constants::TapeCountFlag)) {
+      return parseTapeCount(line);
+    }
+    return parseTransitions(line);
   }
 
+  auto machine() -> TuringState & { return turingState; }
+  auto runOptions() const -> const Options & { return options; }
+  auto runInput() const -> std::string_view { return input; }
+
+  // #Q = {names}
   auto parseStates(std::string_view line) -> Error {
-    static auto statesReg = std::regex{R"(#Q\s*=\s*\{([a-zA-Z0-9_, ]+)\})"};
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, statesReg)) {
+    auto list = braces(line, constants::StatesFlag, isListChar, false);
+    if (!list) {
       return TuringError::ParserInvalidStates;
     }
-    auto stateString = utils::replace(match[1].str(), " ", "");
-    auto lineStates = utils::split(stateString, ',');
-    for (auto state : lineStates) {
+    return forEachItem(*list, [this](std::string_view state) -> Error {
       if (state.empty()) {
         return TuringError::ParserInvalidStates;
       }
-      turingState.states.emplace(state);
-    }
-    return TuringError::Ok;
+      // names point into the set, whose nodes never move
+      declaredStates.emplace(*turingState.states.emplace(state).first);
+      return TuringError::Ok;
+    });
   }
 
+  // #S = {symbols}, possibly empty
   auto parseSymbols(std::string_view line) -> Error {
-    static auto symbolsReg = std::regex{R"(#S\s*=\s*\{(.*)\})"};
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, symbolsReg)) {
+    auto list = braces(line, constants::SymbolsFlags, isAnyChar, true);
+    if (!list) {
       return TuringError::ParserInvalidSymbols;
     }
-    auto symbolString = utils::replace(match[1].str(), " ", "");
-    if (symbolString.empty()) {
+    if (list->find_first_not_of(' ') == std::string_view::npos) {
       return TuringError::Ok;
     }
-    auto lineSymbols = utils::split(symbolString, ',');
-    for (auto symbol : lineSymbols) {
-      if (symbol.size() != 1) {
+    return forEachItem(*list, [this](std::string_view symbol) -> Error {
+      if (!isSymbol(symbol, constants::InvalidSymbols)) {
         return TuringError::ParserInvalidSymbols;
       }
-      auto sym = symbol[0];
-      if (sym < 32 || sym > 126 ||
-          constants::InvalidSymbols.find(sym) != std::string_view::npos) {
-        return TuringError::ParserInvalidSymbols;
-      }
-      turingState.symbols.emplace(sym);
-    }
-    return TuringError::Ok;
+      turingState.symbols.emplace(symbol[0]);
+      return TuringError::Ok;
+    });
   }
 
+  // #G = {symbols}
   auto parseTapeSymbols(std::string_view line) -> Error {
-    static auto tapeSymbolsReg = std::regex{R"(#G\s*=\s*\{(.*)\})"};
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, tapeSymbolsReg)) {
+    auto list = braces(line, constants::TapeSymbolsFlags, isAnyChar, true);
+    if (!list) {
       return TuringError::ParserInvalidTapeSymbols;
     }
-    auto tapeSymbolString = utils::replace(match[1].str(), " ", "");
-    auto lineTapeSymbols = utils::split(tapeSymbolString, ',');
-    for (auto tapeSymbol : lineTapeSymbols) {
-      if (tapeSymbol.size() != 1) {
-        return TuringError::ParserInvalidTapeSymbols;
-      }
-      auto tapeSym = tapeSymbol[0];
-      if (tapeSym < 32 || tapeSym > 126 ||
-          constants::InvalidTapeSymbols.find(tapeSym) !=
-              std::string_view::npos) {
+    return forEachItem(*list, [this](std::string_view symbol) -> Error {
+      if (!isSymbol(symbol, constants::InvalidTapeSymbols)) {
         return TuringError::ParserInvalidTapeSymbols;
       }
-      turingState.tapeSymbols.emplace(tapeSym);
-    }
-    return TuringError::Ok;
+      turingState.tapeSymbols.emplace(symbol[0]);
+      declaredTapeSymbols[static_cast<unsigned char>(symbol[0])] = true;
+      return TuringError::Ok;
+    });
   }
 
+  // #q0 = name, defined once
   auto parseInitialState(std::string_view line) -> Error {
-    static auto initialStateReg = std::regex{R"(#q0\s*=\s*([a-zA-Z0-9_]+))"};
     if (!turingState.initialState.empty()) {
+      errorAt = line.data();
       return TuringError::ParserDuplicateDefinition;
     }
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, initialStateReg)) {
+    auto name = value(line, constants::InitialStateFlags, isNameChar);
+    if (!name) {
       return TuringError::ParserInvalidInitialState;
     }
-    turingState.initialState = match[1].str();
+    turingState.initialState = *name;
     return TuringError::Ok;
   }
 
+  // #B = _
   auto parseBlankSymbol(std::string_view line) -> Error {
-    static auto blankSymbolReg = std::regex{R"(#B\s*=\s*([a-zA-Z0-9_]+))"};
-    auto match = utils::svmatch{};
-
-    if (!std::regex_match(line.begin(), line.end(), match, blankSymbolReg)) {
-      return TuringError::ParserInvalidBlankSymbol;
-    }
-    auto blankSymbol = match[1].str();
-    if (blankSymbol.size() != 1) {
+    auto blank = value(line, constants::BlankSymbolFlag, isNameChar);
+    if (!blank) {
       return TuringError::ParserInvalidBlankSymbol;
     }
-    auto sym = blankSymbol[0];
-    if (sym != '_') {
+    if (*blank != "_") {
+      errorAt = blank->data();
       return TuringError::ParserInvalidBlankSymbol;
     }
-    turingState.blankSymbol = sym;
+    turingState.blankSymbol = (*blank)[0];
     return TuringError::Ok;
   }
 
+  // #F = {names}, possibly empty
   auto parseFinalStates(std::string_view line) -> Error {
-    static auto finalStatesReg =
-        std::regex{R"(#F\s*=\s*\{([a-zA-Z0-9_, ]*)\})"};
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, finalStatesReg)) {
+    auto list = braces(line, constants::FinalStatesFlag, isListChar, true);
+    if (!list) {
       return TuringError::ParserInvalidFinalStates;
     }
-    auto finalStateString = utils::replace(match[1].str(), " ", "");
-    if (finalStateString.empty()) {
+    if (list->find_first_not_of(' ') == std::string_view::npos) {
       return TuringError::Ok;
     }
-    auto lineFinalStates = utils::split(finalStateString, ',');
-    for (auto finalState : lineFinalStates) {
+    return forEachItem(*list, [this](std::string_view finalState) -> Error {
       if (finalState.empty()) {
         return TuringError::ParserInvalidFinalStates;
       }
       turingState.finalStates.emplace(finalState);
-    }
-    return TuringError::Ok;
+      return TuringError::Ok;
+    });
   }
 
+  // #N = digits, at least 1
   auto parseTapeCount(std::string_view line) -> Error {
-    static auto tapeCountReg = std::regex{R"(#N\s*=\s*(\d+))"};
-    auto match = utils::svmatch{};
-    if (!std::regex_match(line.begin(), line.end(), match, tapeCountReg)) {
+    auto digits = value(line, constants::TapeCountFlag, isDigit);
+    if (!digits) {
       return TuringError::ParserInvalidTapeCount;
     }
-    auto tapeCount = std::stoi(match[1].str());
-    if (tapeCount < 1) {
+    auto tapeCount = 0;
+    auto [end, ec] = std::from_chars(
+        digits->data(), digits->data() + digits->size(), tapeCount);
+    if (ec != std::errc{} || tapeCount < 1) {
+      errorAt = digits->data();
       return TuringError::ParserInvalidTapeCount;
     }
     turingState.tapeCount = tapeCount;
     return TuringError::Ok;
   }
 
+  // state input output moves next
   auto parseTransitions(std::string_view line) -> Error {
-    auto symbols = utils::split(line);
-    utils::omitEmpty(symbols);
-    if (symbols.size() != 5) {
+    auto fields = std::array<std::string_view, 5>{};
+    auto count = Size{0};
+    for (auto rest = line; !rest.empty();) {
+      auto start = rest.find_first_not_of(' ');
+      if (start == std::string_view::npos) {
+        break;
+      }
+      rest.remove_prefix(start);
+      if (count == fields.size()) {
+        errorAt = rest.data();
+        return TuringError::ParserInvalidTransition;
+      }
+      auto size = std::min(rest.find(' '), rest.size());
+      fields[count++] = rest.substr(0, size);
+      rest.remove_prefix(size);
+    }
+    if (count != fields.size()) {
+      errorAt = line.data() + line.size();
       return TuringError::ParserInvalidTransition;
     }
 
-    auto state = symbols[0];
-    auto symbol = symbols[1];
-    auto nextSymbol = symbols[2];
-    auto direction = symbols[3];
-
-    if (symbol.size() != turingState.tapeCount ||
-        nextSymbol.size() != turingState.tapeCount ||
-        direction.size() != turingState.tapeCount) {
-      return TuringError::ParserInvalidTransition;
+    auto [state, symbol, nextSymbol, direction, nextState] = fields;
+    for (auto field : {symbol, nextSymbol, direction}) {
+      if (field.size() != turingState.tapeCount) {
+        errorAt = field.data();
+        return TuringError::ParserInvalidTransition;
+      }
     }
 
     auto moves = Moves{};
     moves.reserve(turingState.tapeCount);
-    for (auto ch : direction) {
+    for (const auto &ch : direction) {
       switch (ch) {
       case 'l':
         moves.emplace_back(Move::Left);
@@ -303,25 +444,178 @@ public:
         moves.emplace_back(Move::Stay);
         break;
       default:
+        errorAt = &ch;
         return TuringError::ParserInvalidTransition;
       }
     }
-    auto nextState = symbols[4];
 
-    auto transition = Transition(state, symbol, nextState, nextSymbol, moves);
-    if (!transition.isValid(turingState)) {
+    // the same checks as Transition::isValid, on hashed names
+    if (auto undeclared = undeclaredField(fields); undeclared != nullptr) {
+      errorAt = undeclared;
       return TuringError::ParserInvalidTransition;
     }
 
-    if (transition.isStarTransition()) {
-      for (auto &&convertedTransition :
-           transition.convertTransitions(turingState)) {
-        turingState.transitions.insert(std::move(convertedTransition));
+    auto transition =
+        Transition(state, symbol, nextState, nextSymbol, std::move(moves));
+    turingState.transitions.insert(std::move(transition));
+    return TuringError::Ok;
+  }
+
+private:
+  static auto isNameChar(char ch) -> bool {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+           (ch >= '0' && ch <= '9') || ch == '_';
+  }
+
+  static auto isListChar(char ch) -> bool {
+    return isNameChar(ch) || ch == ',' || ch == ' ';
+  }
+
+  static auto isDigit(char ch) -> bool { return ch >= '0' && ch <= '9'; }
+
+  // anything but a line break
+  static auto isAnyChar(char ch) -> bool { return ch != '\r' && ch != '\n'; }
+
+  static auto isSymbol(std::string_view symbol, std::string_view invalid)
+      -> bool {
+    return symbol.size() == 1 && symbol[0] >= 32 && symbol[0] <= 126 &&
+           invalid.find(symbol[0]) == std::string_view::npos;
+  }
+
+  static auto skipWhitespace(std::string_view text) -> std::string_view {
+    auto start = text.find_first_not_of(constants::Whitespace);
+    return text.substr(std::min(start, text.size()));
+  }
+
+  // Skips "<flag> =" and the blanks around '=', returning what follows.
+  auto definition(std::string_view line, std::string_view flag)
+      -> std::optional<std::string_view> {
+    auto rest = skipWhitespace(line.substr(flag.size()));
+    if (!rest.starts_with('=')) {
+      errorAt = rest.data();
+      return std::nullopt;
+    }
+    return skipWhitespace(rest.substr(1));
+  }
+
+  // "<flag> = value" where the whole value satisfies accepts.
+  auto value(std::string_view line, std::string_view flag,
+             bool (*accepts)(char)) -> std::optional<std::string_view> {
+    auto rest = definition(line, flag);
+    if (!rest) {
+      return std::nullopt;
+    }
+    auto bad = std::find_if_not(rest->begin(), rest->end(), accepts);
+    if (rest->empty() || bad != rest->end()) {
+      errorAt = rest->data() + (bad - rest->begin());
+      return std::nullopt;
+    }
+    return rest;
+  }
+
+  // "<flag> = {list}" where every character of list satisfies accepts.
+  auto braces(std::string_view line, std::string_view flag,
+              bool (*accepts)(char), bool allowEmpty)
+      -> std::optional<std::string_view> {
+    auto rest = definition(line, flag);
+    if (!rest) {
+      return std::nullopt;
+    }
+    if (!rest->starts_with('{')) {
+      errorAt = rest->data();
+      return std::nullopt;
+    }
+    if (rest->size() < 2 || !rest->ends_with('}')) {
+      errorAt = rest->data() + rest->size();
+      return std::nullopt;
+    }
+    auto list = rest->substr(1, rest->size() - 2);
+    auto bad = std::find_if_not(list.begin(), list.end(), accepts);
+    if ((list.empty() && !allowEmpty) || bad != list.end()) {
+      errorAt = list.data() + (bad - list.begin());
+      return std::nullopt;
+    }
+    return list;
+  }
+
+  // Calls fn on every comma separated item of a list, with the spaces in the
+  // item removed, stopping at the first error.
+  template <typename F> auto forEachItem(std::string_view list, F fn) -> Error {
+    while (true) {
+      auto end = list.find(',');
+      auto item = list.substr(0, end);
+      auto name = item;
+      if (item.find(' ') != std::string_view::npos) {
+        scratch.clear();
+        std::copy_if(item.begin(), item.end(), std::back_inserter(scratch),
+                     [](char ch) { return ch != ' '; });
+        name = scratch;
+      }
+      if (auto e = fn(name); e != TuringError::Ok) {
+        errorAt = item.data();
+        return e;
       }
-    } else {
-      turingState.transitions.insert(std::move(transition));
+      if (end == std::string_view::npos) {
+        return TuringError::Ok;
+      }
+      list.remove_prefix(end + 1);
     }
-    return TuringError::Ok;
+  }
+
+  // Finds the field of a transition naming an undeclared state or symbol.
+  auto undeclaredField(const std::array<std::string_view, 5> &fields) const
+      -> const char * {
+    for (auto i : {Size{0}, Size{4}}) {
+      if (!declaredStates.contains(fields[i])) {
+        return fields[i].data();
+      }
+    }
+    for (auto i : {Size{1}, Size{2}}) {
+      for (const auto &ch : fields[i]) {
+        if (ch != Transition::Wildcard &&
+            !declaredTapeSymbols[static_cast<unsigned char>(ch)]) {
+          return &ch;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  static auto describe(Error error) -> std::string_view {
+    switch (static_cast<TuringError>(error.value())) {
+    case TuringError::ParserInvalidStates:
+      return "invalid states";
+    case TuringError::ParserInvalidSymbols:
+      return "invalid input symbols";
+    case TuringError::ParserInvalidTapeSymbols:
+      return "invalid tape symbols";
+    case TuringError::ParserInvalidInitialState:
+      return "invalid initial state";
+    case TuringError::ParserInvalidBlankSymbol:
+      return "invalid blank symbol";
+    case TuringError::ParserInvalidFinalStates:
+      return "invalid final states";
+    case TuringError::ParserInvalidTapeCount:
+      return "invalid tape count";
+    case TuringError::ParserDuplicateDefinition:
+      return "duplicate definition";
+    default:
+      return "invalid transition";
+    }
+  }
+
+  // Shows the offending line with a caret under the column of the error.
+  auto reportError(Error error, std::string_view rLine, Size lineNumber) const
+      -> void {
+    auto column = Size{0};
+    if (errorAt >= rLine.data() && errorAt <= rLine.data() + rLine.size()) {
+      column = static_cast<Size>(errorAt - rLine.data());
+    }
+    auto caret = std::string{rLine.substr(0, column)};
+    std::replace_if(
+        caret.begin(), caret.end(), [](char ch) { return ch != '\t'; }, ' ');
+    logger.verbose(Logger::Level::Error, constants::SyntaxErrorFormat,
+                   describe(error), lineNumber, column + 1, rLine, caret);
   }
 };
 } // namespace turing::parser
@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+
+#include <Machine.h>
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+namespace constants {
+
+constexpr auto ProfileHeader =
+    "==================== PROFILE ====================";
+constexpr auto ProfileFooter =
+    "==================== END ====================";
+
+} // namespace constants
+
+// Profile counts what a run spends its steps on: the hits of every
+// transition and the steps taken in every state, in flat arrays indexed by
+// action and state id, and how far each head reaches on either side. Visits
+// of states and moves of heads follow from the hits once the run is over, so
+// a step only adds to two counters and compares the heads.
+struct Profile {
+private:
+  std::shared_ptr<const Program> program;
+  std::vector<Steps> hits;       // per action
+  std::vector<Steps> stateSteps; // per state
+  std::vector<Position> lowest;  // per tape, leftmost cell reached
+  std::vector<Position> highest; // per tape, rightmost cell reached
+  std::vector<Steps> grewLeft;   // per tape, cells first reached on the left
+  std::vector<Steps> grewRight;
+  StateId initial;
+
+  struct Row {
+    std::string name;
+    std::vector<Steps> values;
+  };
+
+public:
+  Profile(std::shared_ptr<const Program> program, StateId state,
+          const Tapes &tapes)
+      : program(std::move(program)), hits(this->program->actions(), 0),
+        stateSteps(this->program->states(), 0),
+        grewLeft(tapes.size(), 0), grewRight(tapes.size(), 0),
+        initial(state) {
+    for (const auto &tape : tapes) {
+      lowest.push_back(tape.head());
+      highest.push_back(tape.head());
+    }
+  }
+
+  // Counts count steps of action taken from state, with the heads where
+  // they ended up.
+  auto record(StateId state, ActionId action, Steps count, const Tapes &tapes)
+      -> void {
+    hits[action] += count;
+    stateSteps[state] += count;
+    for (auto i = Size{0}; i < tapes.size(); i++) {
+      auto head = tapes[i].head();
+      if (head < lowest[i]) {
+        grewLeft[i] += static_cast<Steps>(lowest[i] - head);
+        lowest[i] = head;
+      } else if (head > highest[i]) {
+        grewRight[i] += static_cast<Steps>(head - highest[i]);
+        highest[i] = head;
+      }
+    }
+  }
+
+  // Sorted tables of the states and of the transitions that fired, most
+  // steps first. Transitions are labeled from machine when the program was
+  // compiled from it.
+  auto table(const TuringState &machine) const
+      -> std::string {
+    auto total = totalSteps();
+    auto out = std::string{constants::ProfileHeader};
+    out += utils::format("\nSteps : {}\n", total);
+
+    auto states = std::vector<Row>{};
+    auto visits = stateVisits();
+    for (auto state = StateId{0}; state < program->states(); state++) {
+      states.push_back({std::string{program->stateName(state)},
+                        {visits[state], stateSteps[state]}});
+    }
+    sortRows(states, 1);
+    appendTable(out, {"State", "Visits", "Steps"}, states, 1, total);
+
+    auto transitions = std::vector<Row>{};
+    auto unused = Size{0};
+    for (auto action = ActionId{0}; action < program->actions(); action++) {
+      if (hits[action] == 0) {
+        unused++;
+        continue;
+      }
+      transitions.push_back({label(machine, action), {hits[action]}});
+    }
+    sortRows(transitions, 0);
+    out += '\n';
+    appendTable(out, {"Transition", "Hits"}, transitions, 0, total);
+    out += utils::format("Unused transitions: {}\n", unused);
+
+    auto moves = headMoves();
+    for (auto i = Size{0}; i < lowest.size(); i++) {
+      out += utils::format(
+          "Tape{} : moves left {} stay {} right {}, reached [{}, {}], "
+          "new cells left {} right {}\n",
+          i, moves[i][0], moves[i][1], moves[i][2], lowest[i], highest[i],
+          grewLeft[i], grewRight[i]);
+    }
+    out += constants::ProfileFooter;
+    return out;
+  }
+
+  auto json(const TuringState &machine) const
+      -> std::string {
+    auto visits = stateVisits();
+    auto out = utils::format("{\"steps\":{},\"states\":[", totalSteps());
+    for (auto state = StateId{0}; state < program->states(); state++) {
+      out += utils::format("{}{\"name\":{},\"visits\":{},\"steps\":{}}",
+                           state == 0 ? "" : ",",
+                           quote(program->stateName(state)), visits[state],
+                           stateSteps[state]);
+    }
+    out += "],\"transitions\":[";
+    for (auto action = ActionId{0}; action < program->actions(); action++) {
+      out += utils::format("{}{\"id\":{},\"transition\":{},\"hits\":{}}",
+                           action == 0 ? "" : ",", action,
+                           quote(label(machine, action)),
+                           hits[action]);
+    }
+    out += "],\"tapes\":[";
+    auto moves = headMoves();
+    for (auto i = Size{0}; i < lowest.size(); i++) {
+      out += utils::format(
+          "{}{\"left\":{},\"stay\":{},\"right\":{},\"lowest\":{},"
+          "\"highest\":{},\"newLeft\":{},\"newRight\":{}}",
+          i == 0 ? "" : ",", moves[i][0], moves[i][1], moves[i][2], lowest[i],
+          highest[i], grewLeft[i], grewRight[i]);
+    }
+    out += "]}";
+    return out;
+  }
+
+private:
+  auto totalSteps() const -> Steps {
+    return std::accumulate(hits.begin(), hits.end(), Steps{0});
+  }
+
+  // Entries into every state, the start of the run included.
+  auto stateVisits() const -> std::vector<Steps> {
+    auto visits = std::vector<Steps>(program->states(), 0);
+    visits[initial]++;
+    for (auto action = ActionId{0}; action < program->actions(); action++) {
+      visits[program->next(action)] += hits[action];
+    }
+    return visits;
+  }
+
+  // Moves of every head, left, stay and right.
+  auto headMoves() const
+      -> std::vector<std::array<Steps, 3>> {
+    auto moves = std::vector<std::array<Steps, 3>>(lowest.size(), {0, 0, 0});
+    for (auto action = ActionId{0}; action < program->actions(); action++) {
+      auto move = program->move(action);
+      for (auto i = Size{0}; i < move.size(); i++) {
+        moves[i][static_cast<int>(move[i]) + 1] += hits[action];
+      }
+    }
+    return moves;
+  }
+
+  auto label(const TuringState &machine, ActionId action) const
+      -> std::string {
+    if (machine.transitions.size() == program->actions()) {
+      return machine.transitions[action].toString();
+    }
+    // a compiled image keeps what transitions do, not what they match
+    auto moves = std::string{};
+    for (auto move : program->move(action)) {
+      moves += move == Move::Left ? 'l' : move == Move::Right ? 'r' : '*';
+    }
+    return utils::format("#{} {} {} {}", action, program->output(action), moves,
+                         program->stateName(program->next(action)));
+  }
+
+  static auto sortRows(std::vector<Row> &rows, Size column) -> void {
+    std::stable_sort(rows.begin(), rows.end(),
+                     [column](const Row &a, const Row &b) {
+                       return a.values[column] > b.values[column];
+                     });
+  }
+
+  // Columns are padded to their widest cell, followed by the share of the
+  // total steps taken by the row.
+  static auto appendTable(std::string &out,
+                          const std::vector<std::string_view> &header,
+                          const std::vector<Row> &rows, Size shareColumn,
+                          Steps total) -> void {
+    auto cells = std::vector<std::vector<std::string>>{};
+    cells.emplace_back(header.begin(), header.end());
+    cells.back().emplace_back("Share");
+    for (const auto &row : rows) {
+      auto &line = cells.emplace_back();
+      line.push_back(row.name);
+      for (auto value : row.values) {
+        line.push_back(std::to_string(value));
+      }
+      auto share = std::array<char, 16>{};
+      std::snprintf(share.data(), share.size(), "%.1f%%",
+                    total == 0 ? 0.0
+                               : 100.0 *
+                                     static_cast<double>(
+                                         row.values[shareColumn]) /
+                                     static_cast<double>(total));
+      line.emplace_back(share.data());
+    }
+
+    auto widths = std::vector<Size>(cells.front().size(), 0);
+    for (const auto &line : cells) {
+      for (auto i = Size{0}; i < line.size(); i++) {
+        widths[i] = std::max(widths[i], line[i].size());
+      }
+    }
+    for (const auto &line : cells) {
+      for (auto i = Size{0}; i < line.size(); i++) {
+        auto padding = std::string(widths[i] - line[i].size(), ' ');
+        // names to the left, numbers to the right
+        out += i == 0 ? line[i] + padding : "  " + padding + line[i];
+      }
+      out += '\n';
+    }
+  }
+
+  static auto quote(std::string_view text) -> std::string {
+    auto out = std::string{"\""};
+    for (auto ch : text) {
+      if (ch == '"' || ch == '\\') {
+        out += '\\';
+      }
+      out += ch;
+    }
+    return out + '"';
+  }
+};
+
+} // namespace turing::simulator
@@ -0,0 +1,771 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+
+#include <Errors.h>
+#include <Machine.h>
+#include <MappedFile.h>
+#include <Tape.h>
+
+namespace turing::machine {
+
+using StateId = std::uint32_t;
+using SymbolId = std::uint8_t;
+using ActionId = std::uint32_t;
+using Key = std::uint64_t;
+using Steps = std::uint64_t;
+
+// Program is the compiled, integer-indexed form of a TuringState. States and
+// tape symbols are interned into small integers, the N symbols read by the
+// heads are packed into one Key, and every transition becomes an action
+// reachable through a flat table indexed by (StateId, Key).
+//
+// Wildcard transitions stay patterns unless the state has a dense row, so
+// memory scales with the source file. Action ids follow declaration order,
+// which is also the precedence order when several transitions match.
+//
+// All tables live in one position-independent image: a header followed by
+// aligned sections. A compiled program owns its image, a loaded one maps it
+// from a file, and both read it in place, so loading rebuilds nothing. Only
+// the rows of the Wide layout, keyed by strings, live outside the image.
+struct Program {
+public:
+  enum class Layout : std::uint32_t {
+    Dense,  // one row of 2^keyBits actions per state
+    Sparse, // one hash table of (state, key) plus patterns per state
+    Wide,   // keys do not fit in 64 bits, rows are keyed by raw symbols
+  };
+
+  static constexpr auto NoAction = ~ActionId{0};
+  static constexpr auto DenseTableLimit = Size{1} << 22;
+  static constexpr auto DenseExpansionLimit = DenseTableLimit * 4;
+
+  static constexpr auto ImageMagic = std::array<char, 8>{'T', 'U', 'R', 'I',
+                                                         'N', 'G', 'M', 'C'};
+  static constexpr auto ImageVersion = std::uint32_t{1};
+
+private:
+  struct Pattern {
+    Key mask;  // fields holding a concrete symbol
+    Key value; // concrete symbols, packed
+    Key stars; // fields holding a wildcard
+    ActionId action;
+    std::uint32_t reserved;
+  };
+
+  // One slot of the open-addressing table shared by every sparse row.
+  struct Entry {
+    Key key;
+    StateId state; // NoState marks an empty slot
+    ActionId action;
+  };
+
+  static constexpr auto NoState = ~StateId{0};
+
+  struct WidePattern {
+    Symbols input;
+    ActionId action;
+  };
+
+  // Hashes symbols and views of them alike, so that a row is looked up by
+  // the symbols under the heads without copying them.
+  struct SymbolsHash {
+    using is_transparent = void;
+
+    auto operator()(SymbolsRef symbols) const -> std::size_t {
+      return std::hash<SymbolsRef>{}(symbols);
+    }
+  };
+
+  struct WideRow {
+    std::unordered_map<Symbols, ActionId, SymbolsHash, std::equal_to<>> exact;
+    std::vector<WidePattern> patterns;
+  };
+
+  enum Section : std::uint32_t {
+    StateNameStarts,
+    StateNames,
+    Accepting,
+    SymbolIds,
+    InputSymbols,
+    SymbolNames,
+    Table,
+    Entries,
+    PatternStarts,
+    Patterns,
+    NextStates,
+    Outputs,
+    HeadMoves,
+    SectionCount,
+  };
+
+  struct Extent {
+    std::uint64_t offset;
+    std::uint64_t size; // in bytes
+  };
+
+  struct Header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t byteOrder; // ByteOrder as written by the compiling host
+    std::uint64_t imageSize;
+    std::uint64_t tapeCount;
+    std::uint64_t states;
+    std::uint64_t actions;
+    std::uint64_t symbols;
+    std::uint64_t symbolBits;
+    std::uint32_t layout;
+    std::uint32_t initial;
+    std::uint32_t starSymbols;
+    std::uint32_t blank;
+    std::array<Extent, SectionCount> sections;
+  };
+
+  static constexpr auto ByteOrder = std::uint32_t{0x01020304};
+  static constexpr auto SectionAlignment = Size{8};
+
+  // Tables gathered by compile() before they are laid out in an image.
+  struct Builder {
+    std::vector<State> stateNames;
+    std::vector<std::uint8_t> accepting;
+    std::array<SymbolId, 256> symbolIds{};
+    std::array<std::uint8_t, 256> inputSymbols{};
+    Symbols symbolNames;
+    std::vector<ActionId> table;
+    std::vector<Entry> exact; // in declaration order, duplicates included
+    std::vector<std::vector<Pattern>> patterns;
+    std::vector<StateId> nextStates;
+    Symbols outputs;
+    Moves moves;
+  };
+
+  Size tapeCount = 0;
+  Symbol blank = '_';
+  Layout layout = Layout::Dense;
+  Size symbolBits = 1;
+  Size keyBits = 0;
+  Key fieldMask = 1;
+  StateId initial = 0;
+  SymbolId starSymbols = 0; // ids 1..starSymbols are matched by a wildcard
+
+  std::shared_ptr<const void> storage; // keeps the image alive
+  std::span<const std::byte> bytes;
+
+  std::span<const std::uint32_t> stateNameStarts;
+  std::string_view stateNames;
+  std::span<const std::uint8_t> accepting;
+  std::span<const SymbolId> symbolIds;
+  std::span<const std::uint8_t> inputSymbols;
+  SymbolsRef symbolNames;
+  std::span<const ActionId> table;
+  std::span<const Entry> entries;
+  std::span<const std::uint32_t> patternStarts;
+  std::span<const Pattern> patterns;
+  std::span<const StateId> nextStates;
+  SymbolsRef outputs;
+  MovesRef moves;
+
+  std::vector<WideRow> wideRows;
+
+public:
+  // States listed in order get the first ids, in that order, so that their
+  // rows sit next to each other.
+  static auto compile(const TuringState &state,
+                      std::span<const State> order = {}) -> Program {
+    auto program = Program{};
+    auto builder = Builder{};
+    program.tapeCount = state.tapeCount;
+    program.blank = state.blankSymbol;
+
+    auto stateIds = std::unordered_map<State, StateId>{};
+    auto internState = [&](const State &name) -> StateId {
+      auto [it, inserted] = stateIds.try_emplace(
+          name, static_cast<StateId>(builder.stateNames.size()));
+      if (inserted) {
+        builder.stateNames.emplace_back(name);
+      }
+      return it->second;
+    };
+    for (const auto &name : order) {
+      internState(name);
+    }
+    for (const auto &name : state.states) {
+      internState(name);
+    }
+    program.initial = internState(state.initialState);
+    for (const auto &name : state.finalStates) {
+      internState(name);
+    }
+    builder.accepting.assign(builder.stateNames.size(), 0);
+    for (const auto &name : state.finalStates) {
+      builder.accepting[stateIds.at(name)] = 1;
+    }
+
+    // blank is always 0, then the non-blank tape symbols, then input symbols
+    // that never appear in #G
+    auto internSymbol = [&builder, &program](Symbol symbol) {
+      auto &id = builder.symbolIds[static_cast<unsigned char>(symbol)];
+      if (builder.symbolNames.empty() ||
+          (id == 0 && symbol != program.blank)) {
+        id = static_cast<SymbolId>(builder.symbolNames.size());
+        builder.symbolNames.push_back(symbol);
+      }
+    };
+    internSymbol(program.blank);
+    for (auto symbol : state.tapeSymbols) {
+      internSymbol(symbol);
+    }
+    program.starSymbols = static_cast<SymbolId>(builder.symbolNames.size() - 1);
+    for (auto symbol : state.symbols) {
+      internSymbol(symbol);
+      builder.inputSymbols[static_cast<unsigned char>(symbol)] = 1;
+    }
+
+    // the lookups below read the symbols through the builder until the
+    // image is laid out
+    program.symbolIds = builder.symbolIds;
+    program.symbolNames = builder.symbolNames;
+    program.symbolBits = std::max<Size>(
+        1, std::bit_width(static_cast<Size>(builder.symbolNames.size() - 1)));
+    program.keyBits = program.symbolBits * program.tapeCount;
+    program.fieldMask = (Key{1} << program.symbolBits) - 1;
+    auto stateCount = builder.stateNames.size();
+    program.layout = program.chooseLayout(state.transitions, stateCount);
+
+    switch (program.layout) {
+    case Layout::Dense:
+      builder.table.assign(stateCount << program.keyBits, NoAction);
+      break;
+    case Layout::Sparse:
+      builder.patterns.resize(stateCount);
+      break;
+    case Layout::Wide:
+      program.wideRows.resize(stateCount);
+      break;
+    }
+
+    builder.nextStates.reserve(state.transitions.size());
+    builder.outputs.reserve(state.transitions.size() * program.tapeCount);
+    builder.moves.reserve(state.transitions.size() * program.tapeCount);
+    for (const auto &transition : state.transitions) {
+      auto action = static_cast<ActionId>(builder.nextStates.size());
+      auto input = transition.inputSymbols();
+      auto output = Symbols{transition.outputSymbols()};
+      auto headMoves = transition.headMoves();
+      for (auto i = Size{0}; i < output.size(); i++) {
+        // a wildcard written under a concrete symbol picks the smallest
+        // non-blank tape symbol
+        if (output[i] == Transition::Wildcard &&
+            input[i] != Transition::Wildcard && program.starSymbols > 0) {
+          output[i] = builder.symbolNames[1];
+        }
+      }
+      builder.nextStates.emplace_back(stateIds.at(transition.nextState()));
+      builder.outputs.append(output);
+      builder.moves.insert(builder.moves.end(), headMoves.begin(),
+                           headMoves.end());
+      if (program.starSymbols > 0 || !transition.isStarTransition()) {
+        program.insert(builder, stateIds.at(transition.currentState()), input,
+                       action);
+      }
+    }
+
+    auto image =
+        std::make_shared<std::vector<std::byte>>(program.layOut(builder));
+    program.view(image, *image);
+    return program;
+  }
+
+  // Reads a program from an image written by save(). Only the header, the
+  // section sizes and the names are checked, so an image cut short or of
+  // another version is refused, while a table damaged in place is not caught.
+  static auto load(std::shared_ptr<const void> owner,
+                   std::span<const std::byte> image) -> utils::Result<Program> {
+    auto program = Program{};
+    if (!program.view(std::move(owner), image) ||
+        program.layout == Layout::Wide || !program.isConsistent()) {
+      return utils::TuringError::ImageInvalid;
+    }
+    return program;
+  }
+
+  static auto load(utils::MappedFile file) -> utils::Result<Program> {
+    auto mapped = std::make_shared<const utils::MappedFile>(std::move(file));
+    return load(mapped, mapped->bytes());
+  }
+
+  auto save(std::ostream &os) const -> utils::Result<> {
+    if (layout == Layout::Wide) {
+      return utils::TuringError::ImageUnsupportedMachine;
+    }
+    os.write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+    return {};
+  }
+
+  auto states() const -> Size { return accepting.size(); }
+  auto actions() const -> Size { return nextStates.size(); }
+  auto tapes() const -> Size { return tapeCount; }
+  auto symbols() const -> Size { return symbolNames.size(); }
+  auto blankSymbol() const -> Symbol { return blank; }
+  auto initialState() const -> StateId { return initial; }
+  auto tableLayout() const -> Layout { return layout; }
+
+  auto stateName(StateId state) const -> StateRef {
+    return stateNames.substr(stateNameStarts[state],
+                             stateNameStarts[state + 1] -
+                                 stateNameStarts[state]);
+  }
+
+  auto accepts(StateId state) const -> bool { return accepting[state] != 0; }
+
+  auto isInputSymbol(Symbol symbol) const -> bool {
+    return inputSymbols[static_cast<unsigned char>(symbol)] != 0;
+  }
+
+  auto symbolId(Symbol symbol) const -> SymbolId {
+    return symbolIds[static_cast<unsigned char>(symbol)];
+  }
+
+  auto symbol(SymbolId id) const -> Symbol { return symbolNames[id]; }
+
+  auto pack(SymbolsRef symbols) const -> Key {
+    auto key = Key{0};
+    for (auto i = Size{0}; i < symbols.size(); i++) {
+      key |= Key{symbolId(symbols[i])} << (i * symbolBits);
+    }
+    return key;
+  }
+
+  auto pack(const Tapes &tapes) const -> Key {
+    auto key = Key{0};
+    auto shift = Size{0};
+    for (const auto &tape : tapes) {
+      key |= Key{symbolId(tape.read())} << shift;
+      shift += symbolBits;
+    }
+    return key;
+  }
+
+  auto find(StateId state, Key key) const -> ActionId {
+    if (layout == Layout::Dense) {
+      return table[(Key{state} << keyBits) | key];
+    }
+    auto best = NoAction;
+    auto mask = entries.size() - 1;
+    for (auto slot = hash(state, key) & mask;; slot = (slot + 1) & mask) {
+      const auto &entry = entries[slot];
+      if (entry.state == NoState) {
+        break;
+      }
+      if (entry.state == state && entry.key == key) {
+        best = entry.action;
+        break;
+      }
+    }
+    for (auto i = patternStarts[state]; i < patternStarts[state + 1]; i++) {
+      const auto &pattern = patterns[i];
+      if (pattern.action > best) {
+        break;
+      }
+      if (matches(pattern, key)) {
+        return pattern.action;
+      }
+    }
+    return best;
+  }
+
+  auto find(StateId state, SymbolsRef symbols) const -> ActionId {
+    if (layout != Layout::Wide) {
+      return find(state, pack(symbols));
+    }
+    const auto &row = wideRows[state];
+#ifdef __cpp_lib_generic_unordered_lookup
+    auto it = row.exact.find(symbols);
+#else
+    auto it = row.exact.find(Symbols{symbols});
+#endif
+    auto best = it == row.exact.end() ? NoAction : it->second;
+    for (const auto &pattern : row.patterns) {
+      if (pattern.action > best) {
+        break;
+      }
+      if (matches(pattern, symbols)) {
+        return pattern.action;
+      }
+    }
+    return best;
+  }
+
+  auto find(StateId state, const Tapes &tapes) const -> ActionId {
+    if (layout == Layout::Wide) {
+      auto heads = Symbols{};
+      return find(state, tapes.read(heads));
+    }
+    return find(state, pack(tapes));
+  }
+
+  // Whether the symbols under the heads match the input of a transition,
+  // wildcards included.
+  auto matches(SymbolsRef input, SymbolsRef symbols) const -> bool {
+    for (auto i = Size{0}; i < symbols.size(); i++) {
+      auto expected = input[i];
+      if (expected == Transition::Wildcard ? !isStarSymbol(symbolId(symbols[i]))
+                                           : expected != symbols[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto next(ActionId action) const -> StateId { return nextStates[action]; }
+
+  auto output(ActionId action) const -> SymbolsRef {
+    return outputs.substr(action * tapeCount, tapeCount);
+  }
+
+  auto move(ActionId action) const -> MovesRef {
+    return moves.subspan(action * tapeCount, tapeCount);
+  }
+
+  // FNV-1a over the image, and over the rows of a wide table, which are
+  // kept outside of it. Programs of the same machine share a fingerprint
+  // whether they were compiled or loaded.
+  auto fingerprint() const -> std::uint64_t {
+    auto value = fnv(FnvBasis, bytes.data(), bytes.size());
+    for (const auto &row : wideRows) {
+      // exact entries are summed up, in whatever order the map holds them
+      auto exact = std::uint64_t{0};
+      for (const auto &[input, action] : row.exact) {
+        exact += fnv(fnv(FnvBasis, input.data(), input.size()), &action,
+                     sizeof(action));
+      }
+      value = fnv(value, &exact, sizeof(exact));
+      for (const auto &pattern : row.patterns) {
+        value = fnv(value, pattern.input.data(), pattern.input.size());
+        value = fnv(value, &pattern.action, sizeof(pattern.action));
+      }
+    }
+    return value;
+  }
+
+private:
+  static constexpr auto FnvBasis = std::uint64_t{0xcbf29ce484222325};
+
+  static auto fnv(std::uint64_t value, const void *data, Size size)
+      -> std::uint64_t {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (auto i = Size{0}; i < size; i++) {
+      value = (value ^ bytes[i]) * 0x100000001b3;
+    }
+    return value;
+  }
+
+  static auto hash(StateId state, Key key) -> Key {
+    auto mixed = key * 0x9e3779b97f4a7c15 + Key{state} * 0xc2b2ae3d27d4eb4f;
+    return mixed ^ (mixed >> 32);
+  }
+
+  auto isStarSymbol(SymbolId id) const -> bool {
+    return id != 0 && id <= starSymbols;
+  }
+
+  auto matches(const Pattern &pattern, Key key) const -> bool {
+    if ((key & pattern.mask) != pattern.value) {
+      return false;
+    }
+    for (auto stars = pattern.stars; stars != 0;) {
+      auto shift = std::countr_zero(stars);
+      if (!isStarSymbol(static_cast<SymbolId>((key >> shift) & fieldMask))) {
+        return false;
+      }
+      stars &= ~(fieldMask << shift);
+    }
+    return true;
+  }
+
+  auto matches(const WidePattern &pattern, SymbolsRef symbols) const -> bool {
+    return matches(SymbolsRef{pattern.input}, symbols);
+  }
+
+  auto compilePattern(SymbolsRef input, ActionId action) const -> Pattern {
+    auto pattern = Pattern{0, 0, 0, action, 0};
+    for (auto i = Size{0}; i < input.size(); i++) {
+      auto field = fieldMask << (i * symbolBits);
+      if (input[i] == Transition::Wildcard) {
+        pattern.stars |= field;
+      } else {
+        pattern.mask |= field;
+        pattern.value |= Key{symbolId(input[i])} << (i * symbolBits);
+      }
+    }
+    return pattern;
+  }
+
+  // Dense rows expand every wildcard up front, which is only worth it while
+  // the expansion stays in the same order of magnitude as the table itself.
+  auto chooseLayout(const Transitions &transitions, Size stateCount) const
+      -> Layout {
+    if (keyBits > 64) {
+      return Layout::Wide;
+    }
+    if (keyBits == 64 || stateCount > (DenseTableLimit >> keyBits)) {
+      return Layout::Sparse;
+    }
+    auto expansion = Size{0};
+    for (const auto &transition : transitions) {
+      auto cells = Size{1};
+      for (auto symbol : transition.inputSymbols()) {
+        if (symbol == Transition::Wildcard) {
+          cells *= starSymbols;
+          if (cells > DenseExpansionLimit) {
+            return Layout::Sparse;
+          }
+        }
+      }
+      expansion += cells;
+      if (expansion > DenseExpansionLimit) {
+        return Layout::Sparse;
+      }
+    }
+    return Layout::Dense;
+  }
+
+  auto insert(Builder &builder, StateId state, SymbolsRef input,
+              ActionId action) -> void {
+    switch (layout) {
+    case Layout::Dense: {
+      auto pattern = compilePattern(input, action);
+      auto row = Key{state} << keyBits;
+      // walk every key matched by the pattern like an odometer whose wheels
+      // are the wildcard fields, keeping earlier definitions in place
+      auto key = pattern.value;
+      for (auto i = Size{0}; i < tapeCount; i++) {
+        if ((pattern.stars >> (i * symbolBits)) & fieldMask) {
+          key |= Key{1} << (i * symbolBits);
+        }
+      }
+      while (true) {
+        auto &entry = builder.table[row | key];
+        if (entry == NoAction) {
+          entry = action;
+        }
+        auto i = Size{0};
+        for (; i < tapeCount; i++) {
+          auto shift = i * symbolBits;
+          if (((pattern.stars >> shift) & fieldMask) == 0) {
+            continue;
+          }
+          auto digit = (key >> shift) & fieldMask;
+          key &= ~(fieldMask << shift);
+          if (digit < starSymbols) {
+            key |= (digit + 1) << shift;
+            break;
+          }
+          key |= Key{1} << shift;
+        }
+        if (i == tapeCount) {
+          break;
+        }
+      }
+      break;
+    }
+    case Layout::Sparse:
+      if (input.find(Transition::Wildcard) == SymbolsRef::npos) {
+        builder.exact.push_back({pack(input), state, action});
+      } else {
+        builder.patterns[state].emplace_back(compilePattern(input, action));
+      }
+      break;
+    case Layout::Wide:
+      if (input.find(Transition::Wildcard) == SymbolsRef::npos) {
+        wideRows[state].exact.try_emplace(Symbols{input}, action);
+      } else {
+        wideRows[state].patterns.push_back({Symbols{input}, action});
+      }
+      break;
+    }
+  }
+
+  // Hashes the exact sparse keys into a table at most half full, keeping the
+  // first declared action of a duplicate key.
+  static auto hashEntries(const std::vector<Entry> &exact)
+      -> std::vector<Entry> {
+    auto capacity = std::bit_ceil(std::max<Size>(exact.size() * 2, 1));
+    auto slots = std::vector<Entry>(capacity, Entry{0, NoState, NoAction});
+    for (const auto &entry : exact) {
+      auto slot = hash(entry.state, entry.key) & (capacity - 1);
+      while (slots[slot].state != NoState &&
+             (slots[slot].state != entry.state ||
+              slots[slot].key != entry.key)) {
+        slot = (slot + 1) & (capacity - 1);
+      }
+      if (slots[slot].state == NoState) {
+        slots[slot] = entry;
+      }
+    }
+    return slots;
+  }
+
+  auto layOut(const Builder &builder) const -> std::vector<std::byte> {
+    auto header = Header{};
+    header.magic = ImageMagic;
+    header.version = ImageVersion;
+    header.byteOrder = ByteOrder;
+    header.tapeCount = tapeCount;
+    header.states = builder.stateNames.size();
+    header.actions = builder.nextStates.size();
+    header.symbols = builder.symbolNames.size();
+    header.symbolBits = symbolBits;
+    header.layout = static_cast<std::uint32_t>(layout);
+    header.initial = initial;
+    header.starSymbols = starSymbols;
+    header.blank = static_cast<unsigned char>(blank);
+
+    auto image = std::vector<std::byte>(sizeof(Header));
+    auto put = [&image, &header](Section section, const auto &data) {
+      auto size = data.size() * sizeof(*data.data());
+      image.resize((image.size() + SectionAlignment - 1) / SectionAlignment *
+                   SectionAlignment);
+      header.sections[section] = {image.size(), size};
+      const auto *first = reinterpret_cast<const std::byte *>(data.data());
+      image.insert(image.end(), first, first + size);
+    };
+
+    auto starts = std::vector<std::uint32_t>{0};
+    auto names = std::string{};
+    for (const auto &name : builder.stateNames) {
+      names += name;
+      starts.push_back(static_cast<std::uint32_t>(names.size()));
+    }
+    put(StateNameStarts, starts);
+    put(StateNames, names);
+    put(Accepting, builder.accepting);
+    put(SymbolIds, builder.symbolIds);
+    put(InputSymbols, builder.inputSymbols);
+    put(SymbolNames, builder.symbolNames);
+    put(Table, builder.table);
+    if (layout == Layout::Sparse) {
+      put(Entries, hashEntries(builder.exact));
+      auto patternStarts = std::vector<std::uint32_t>{0};
+      auto patterns = std::vector<Pattern>{};
+      for (const auto &row : builder.patterns) {
+        patterns.insert(patterns.end(), row.begin(), row.end());
+        patternStarts.push_back(static_cast<std::uint32_t>(patterns.size()));
+      }
+      put(PatternStarts, patternStarts);
+      put(Patterns, patterns);
+    }
+    put(NextStates, builder.nextStates);
+    put(Outputs, builder.outputs);
+    put(HeadMoves, builder.moves);
+
+    header.imageSize = image.size();
+    std::memcpy(image.data(), &header, sizeof(Header));
+    return image;
+  }
+
+  // Points every table into an image after checking that the header fits
+  // it. Contents are checked separately by isConsistent().
+  auto view(std::shared_ptr<const void> owner, std::span<const std::byte> image)
+      -> bool {
+    storage = std::move(owner);
+    bytes = image;
+    auto header = Header{};
+    if (bytes.size() < sizeof(Header)) {
+      return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    if (header.magic != ImageMagic || header.version != ImageVersion ||
+        header.byteOrder != ByteOrder || header.imageSize != bytes.size()) {
+      return false;
+    }
+
+    if (header.states == 0 || header.states >= NoState || header.symbols == 0 ||
+        header.symbols > 256 || header.actions > bytes.size() ||
+        header.initial >= header.states ||
+        header.starSymbols >= header.symbols || header.blank > 255 ||
+        header.layout > static_cast<std::uint32_t>(Layout::Wide) ||
+        header.symbolBits !=
+            std::max<Size>(1, std::bit_width(header.symbols - 1))) {
+      return false;
+    }
+    tapeCount = header.tapeCount;
+    blank = static_cast<Symbol>(header.blank);
+    layout = static_cast<Layout>(header.layout);
+    symbolBits = header.symbolBits;
+    keyBits = symbolBits * tapeCount;
+    fieldMask = (Key{1} << symbolBits) - 1;
+    initial = header.initial;
+    starSymbols = static_cast<SymbolId>(header.starSymbols);
+    if ((layout != Layout::Wide && keyBits > 64) ||
+        (layout == Layout::Dense && keyBits >= 32)) {
+      return false;
+    }
+
+    auto states = header.states;
+    auto cells = header.actions * tapeCount;
+    auto tableSize = layout == Layout::Dense ? states << keyBits : 0;
+    auto sparseStarts = layout == Layout::Sparse ? states + 1 : 0;
+    return section(header, StateNameStarts, stateNameStarts, states + 1) &&
+           section(header, StateNames, stateNames) &&
+           section(header, Accepting, accepting, states) &&
+           section(header, SymbolIds, symbolIds, 256) &&
+           section(header, InputSymbols, inputSymbols, 256) &&
+           section(header, SymbolNames, symbolNames, header.symbols) &&
+           section(header, Table, table, tableSize) &&
+           section(header, Entries, entries) &&
+           section(header, PatternStarts, patternStarts, sparseStarts) &&
+           section(header, Patterns, patterns) &&
+           section(header, NextStates, nextStates, header.actions) &&
+           section(header, Outputs, outputs, cells) &&
+           section(header, HeadMoves, moves, cells);
+  }
+
+  template <typename View>
+  auto section(const Header &header, Section index, View &view,
+               std::optional<Size> count = std::nullopt) const -> bool {
+    using T = std::remove_cvref_t<decltype(*view.data())>;
+    auto [offset, size] = header.sections[index];
+    if (offset % SectionAlignment != 0 || offset > bytes.size() ||
+        size > bytes.size() - offset || size % sizeof(T) != 0 ||
+        (count && size / sizeof(T) != *count)) {
+      return false;
+    }
+    view = View{reinterpret_cast<const T *>(bytes.data() + offset),
+                size / sizeof(T)};
+    return true;
+  }
+
+  // Checks what the header cannot: that the names and the symbol tables,
+  // which take O(states) at most, agree with each other. The action tables
+  // are left as they are, so loading touches no more of the image than a run
+  // reads.
+  auto isConsistent() const -> bool {
+    auto ordered = [](std::span<const std::uint32_t> starts, Size end) {
+      return starts.front() == 0 && starts.back() == end &&
+             std::is_sorted(starts.begin(), starts.end());
+    };
+    if (!ordered(stateNameStarts, stateNames.size()) ||
+        symbolNames[0] != blank ||
+        !std::all_of(symbolIds.begin(), symbolIds.end(),
+                     [this](SymbolId id) { return id < symbols(); })) {
+      return false;
+    }
+    for (auto id = Size{0}; id < symbols(); id++) {
+      if (symbolId(symbolNames[id]) != id) {
+        return false;
+      }
+    }
+    return layout == Layout::Dense || (std::has_single_bit(entries.size()) &&
+                                       ordered(patternStarts, patterns.size()));
+  }
+};
+
+} // namespace turing::machine
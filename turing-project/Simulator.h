@@ -1,8 +1,22 @@
 #pragma once
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include <Budget.h>
+#include <Checkpoint.h>
 #include <Errors.h>
+#include <Explorer.h>
 #include <Logger.h>
+#include <MacroMachine.h>
 #include <Machine.h>
+#include <Options.h>
+#include <Program.h>
+#include <LoopDetector.h>
+#include <Profile.h>
 #include <Tape.h>
+#include <ThreadedMachine.h>
+#include <Trace.h>
 
 namespace turing::simulator {
 
@@ -32,6 +46,8 @@ constexpr auto RunInformationFormat =
     "{}\n"
     "---------------------------------------------";
 
+constexpr auto LoopFormat = "loops with period {}";
+
 constexpr auto EndResultFormat =
     "Result: {}\n"
     "==================== END ====================";
@@ -46,82 +62,476 @@ private:
     Running,
     Accepted,
     Stopped,
+    Paused,   // reached a checkpoint of the budget
+    Exceeded, // ran out of steps or time
+    Looping,  // back in a configuration it has been in before
   };
 
-  TuringState turingState;
+  std::shared_ptr<const Program> program;
+  std::shared_ptr<const ThreadedMachine> threaded; // built on the first run
+  std::shared_ptr<const Explorer> explorer;        // set by explore()
+  Options options;
+  std::string indent; // by the tape count of the program
   Symbols input;
-  State currentState;
-  Tapes tapes;
-  int step;
+  StateId currentState;
+  Tapes _tapes;
+  Steps _step;
   Status status;
+  std::optional<LoopDetector> loops;
+  Steps loopPeriod = 0;
+  std::shared_ptr<TraceWriter> trace;
+  std::shared_ptr<Checkpointer> checkpoints;
+  std::shared_ptr<Profile> profile;
 
-  Simulator(TuringState state, SymbolsRef input)
-      : turingState(std::move(state)), input(input),
-        currentState(turingState.initialState), tapes(turingState, input),
-        step(0), status(Status::Stopped), logger(Logger::instance()) {}
+  // Upper bound of a single sweep, so that a head running into endless
+  // blanks still comes back to the step loop.
+  static constexpr auto SweepLimit = Size{1} << 20;
+  static constexpr auto MacroCheckInterval = Steps{1} << 12;
+
+  Simulator(std::shared_ptr<const Program> program, SymbolsRef input,
+            Options options)
+      : program(std::move(program)), options(options),
+        indent(indentOf(this->program->tapes())), input(input),
+        currentState(this->program->initialState()),
+        _tapes(this->program->tapes(), this->program->blankSymbol(), input),
+        _step(0), status(Status::Stopped), logger(Logger::instance()) {}
 
 public:
-  static auto of(TuringState state, SymbolsRef input) -> Result<Simulator> {
+  static auto of(const TuringState &state, SymbolsRef input,
+                 Options options = {}) -> Result<Simulator> {
+    return of(std::make_shared<const Program>(Program::compile(state)), input,
+              options);
+  }
+
+  static auto of(std::shared_ptr<const Program> program, SymbolsRef input,
+                 Options options = {}) -> Result<Simulator> {
     const auto &logger = Logger::instance();
 
-    for (auto verboseInfo = std::string{}; auto ch : input) {
-      if (!state.symbols.contains(ch)) {
-        verboseInfo += '^';
-        logger.verbose(Logger::Level::Error, constants::InvalidInputFormat,
-                       input, ch, input, verboseInfo);
-        return Error(TuringError::SimulatorIllegalInput);
-      }
-      verboseInfo += ' ';
+    if (auto valid = validate(*program, input); !valid) {
+      return valid.error();
+    }
+
+    if (options.engine == Engine::Macro && program->tapes() != 1) {
+      return Error(TuringError::SimulatorUnsupportedMachine);
+    }
+    if (options.engine == Engine::Threaded &&
+        !ThreadedMachine::supports(*program)) {
+      return Error(TuringError::SimulatorUnsupportedMachine);
     }
 
     logger.verbose(Logger::Level::Info, constants::ValidInputFormat, input);
-    return Simulator(std::move(state), input);
+    return Simulator(std::move(program), input, options);
+  }
+
+  // Starts over on another input, reusing the memory of the tapes.
+  auto reset(SymbolsRef newInput) -> Result<> {
+    if (auto valid = validate(*program, newInput); !valid) {
+      return valid;
+    }
+    logger.verbose(Logger::Level::Info, constants::ValidInputFormat, newInput);
+    input = newInput;
+    currentState = program->initialState();
+    _tapes.reset(newInput);
+    _step = 0;
+    status = Status::Stopped;
+    return {};
+  }
+
+  // Lets the nondeterministic engine take every transition of machine, the
+  // source the program was compiled from.
+  auto explore(const TuringState &machine) -> Result<> {
+    if (!Explorer::supports(*program, machine)) {
+      return TuringError::SimulatorUnsupportedMachine;
+    }
+    explorer = std::make_shared<const Explorer>(program, machine, options.jobs);
+    return {};
+  }
+
+  // Continues the run saved in checkpoint, which must be of the same
+  // machine and input.
+  auto restore(const Checkpoint &checkpoint) -> Result<> {
+    if (checkpoint.fingerprint() != program->fingerprint() ||
+        checkpoint.tapes() != _tapes.size() || checkpoint.input() != input) {
+      return TuringError::CheckpointMismatch;
+    }
+    if (checkpoint.state() >= program->states()) {
+      return TuringError::CheckpointInvalid;
+    }
+    currentState = static_cast<StateId>(checkpoint.state());
+    _step = checkpoint.steps();
+    checkpoint.restore(_tapes);
+    return {};
+  }
+
+  // Records every step of the next run in os, see Trace.
+  auto traceTo(std::ostream &os) -> void {
+    trace = std::make_shared<TraceWriter>(os, *program, input);
+  }
+
+  // Prints a recorded run as the verbose output of steps from to to would
+  // show it, with the header and the result when the range covers them.
+  static auto replay(const Trace &trace, Steps from, Steps to) -> void {
+    const auto &logger = Logger::instance();
+    auto _indent = indentOf(trace.tapes());
+    auto tapes = Tapes(trace.tapes(), trace.blankSymbol(), trace.input());
+    auto state = trace.initialState();
+    auto show = [&](Steps step) {
+      if (step >= from && step <= to) {
+        logger.info(constants::RunInformationFormat, _indent, step, _indent,
+                    trace.stateName(state), tapes);
+      }
+    };
+
+    if (from == 0) {
+      logger.info(constants::ValidInputFormat, trace.input());
+    }
+    show(0);
+    auto cursor = trace.cursor();
+    auto last = std::min(to, trace.steps());
+    for (auto step = Steps{1}; step <= last; step++) {
+      auto action = cursor.next();
+      tapes.write(trace.output(action), trace.move(action));
+      state = trace.next(action);
+      show(step);
+    }
+
+    auto end = trace.end();
+    if (!end || to < trace.steps() || *end == Trace::End::Exceeded) {
+      return;
+    }
+    auto result = *end == Trace::End::Looping
+                      ? utils::format(constants::LoopFormat, trace.period())
+                      : tapes.result();
+    logger.info(constants::EndResultFormat, result);
   }
 
   auto run() -> Result<> {
     auto _indent = getIndent();
     logger.verbose(Logger::Level::Info, constants::RunInformationFormat, //
-                   _indent, step, _indent, currentState, tapes);
-    status = Status::Running;
-    while (status == Status::Running) {
-      status = stepNext();
+                   _indent, _step, _indent, program->stateName(currentState),
+                   _tapes);
+    auto accepted = execute();
+    if (accepted.error() == TuringError::SimulatorLimitExceeded) {
+      return accepted;
     }
-    auto result = tapes.result();
+    auto result = accepted.error() == TuringError::SimulatorLoops
+                      ? utils::format(constants::LoopFormat, loopPeriod)
+                      : _tapes.result();
     logger.noVerbose(Logger::Level::Info, result);
     logger.verbose(Logger::Level::Info, constants::EndResultFormat, result);
-    return status == Status::Accepted ? TuringError::Ok
-                                      : TuringError::SimulatorNotAccepted;
+    return accepted;
+  }
+
+  // Runs until the machine halts or exceeds its budget, printing nothing
+  // but verbose steps.
+  auto execute() -> Result<> {
+    auto budget = Budget(options);
+    status = Status::Running;
+    if (options.detectLoops) {
+      _tapes.trackHash();
+      loops.emplace(currentState, _tapes);
+    }
+    if (options.profile) {
+      profile = std::make_shared<Profile>(program, currentState, _tapes);
+    }
+    if (!options.checkpoint.empty()) {
+      checkpoints =
+          std::make_shared<Checkpointer>(options, program->fingerprint());
+    }
+    if (options.engine == Engine::Macro) {
+      status = runMacro(budget);
+    } else if (options.engine == Engine::Threaded) {
+      status = runThreaded(budget);
+    } else if (options.engine == Engine::Nondeterministic) {
+      status = runExplorer(budget);
+    }
+    while (status == Status::Running) {
+      auto checkpoint = budget.checkpoint(_step);
+      while (status == Status::Running) {
+        status = stepNext(checkpoint);
+        if (loops && status == Status::Running) {
+          status = checkLoop();
+        }
+      }
+      if (status == Status::Paused) {
+        status = budget.exceeded(_step) ? Status::Exceeded : Status::Running;
+      }
+      if (checkpoints && status == Status::Running) {
+        checkpoints->tick(currentState, _step, input, _tapes);
+      }
+    }
+    if (checkpoints) {
+      // a run out of budget can be resumed with a larger one
+      if (status == Status::Exceeded) {
+        checkpoints->save(currentState, _step, input, _tapes);
+      }
+      if (!checkpoints->wait()) {
+        logger.error("failed to write checkpoint: {}", options.checkpoint);
+      }
+    }
+    if (trace) {
+      trace->finish(traceEnd(), loopPeriod);
+    }
+    switch (status) {
+    case Status::Accepted:
+      return TuringError::Ok;
+    case Status::Exceeded:
+      return TuringError::SimulatorLimitExceeded;
+    case Status::Looping:
+      return TuringError::SimulatorLoops;
+    default:
+      return TuringError::SimulatorNotAccepted;
+    }
+  }
+
+  auto result() const -> std::string { return _tapes.result(); }
+  auto steps() const -> Steps { return _step; }
+  auto footprint() const -> Size { return _tapes.footprint(); }
+  auto period() const -> Steps { return loopPeriod; }
+  auto tapes() const -> const Tapes & { return _tapes; }
+  auto state() const -> StateRef { return program->stateName(currentState); }
+  auto accepted() const -> bool { return program->accepts(currentState); }
+
+  // Whether the machine stopped, in a final state or with no transition
+  // matching the symbols under its heads.
+  auto halted() const -> bool {
+    return accepted() ||
+           program->find(currentState, _tapes) == Program::NoAction;
+  }
+
+  // Takes up to count steps of the compiled table, whatever the engine, and
+  // returns how many were taken, fewer than count once the machine halts.
+  auto step(Steps count = 1) -> Steps {
+    auto start = _step;
+    auto checkpoint = count > std::numeric_limits<Steps>::max() - _step
+                          ? std::numeric_limits<Steps>::max()
+                          : _step + count;
+    status = Status::Running;
+    while (status == Status::Running) {
+      status = stepNext(checkpoint);
+    }
+    return _step - start;
+  }
+
+  // Steps until predicate holds of the simulator, the machine halts or the
+  // budget of the options runs out, and tells whether predicate holds.
+  template <typename Predicate> auto runUntil(Predicate predicate) -> bool {
+    auto budget = Budget(options);
+    for (auto moving = true; moving && !budget.exceeded(_step);) {
+      for (auto checkpoint = budget.checkpoint(_step);
+           moving && _step < checkpoint;) {
+        if (predicate(std::as_const(*this))) {
+          return true;
+        }
+        moving = step() == 1;
+      }
+    }
+    return predicate(std::as_const(*this));
   }
 
+  // The counts of the last run, if it was profiled.
+  auto profiled() const -> const Profile * { return profile.get(); }
+
 private:
-  auto stepNext() -> Status {
+  static auto validate(const Program &program, SymbolsRef input) -> Result<> {
+    const auto &logger = Logger::instance();
+
+    for (auto verboseInfo = std::string{}; auto ch : input) {
+      if (!program.isInputSymbol(ch)) {
+        verboseInfo += '^';
+        logger.verbose(Logger::Level::Error, constants::InvalidInputFormat,
+                       input, ch, input, verboseInfo);
+        return TuringError::SimulatorIllegalInput;
+      }
+      verboseInfo += ' ';
+    }
+    return {};
+  }
+
+  // Takes the next step, unless the machine halts or has already taken
+  // checkpoint steps.
+  auto stepNext(Steps checkpoint) -> Status {
     auto _indent = getIndent();
-    if (turingState.finalStates.contains(currentState)) {
+    if (program->accepts(currentState)) {
       return Status::Accepted;
     }
-    auto currentSymbols = tapes.read();
-    auto inState = std::make_pair(currentState, currentSymbols);
-    if (!turingState.transitions.contains(inState)) {
+    auto action = program->find(currentState, _tapes);
+    if (action == Program::NoAction) {
       return Status::Stopped;
     }
-    auto [nextState, output, moves] = turingState.transitions.get(inState);
-    tapes.write(output, moves);
-    currentState = nextState;
-    step++;
+    if (_step >= checkpoint) {
+      return Status::Paused;
+    }
+    auto count = options.sweep ? std::min<Steps>(sweepLength(action),
+                                                 checkpoint - _step)
+                               : 1;
+    if (trace) {
+      trace->step(action, count);
+    }
+    if (count > 1) {
+      sweep(action, count);
+    } else {
+      _tapes.write(program->output(action), program->move(action));
+    }
+    if (profile) {
+      profile->record(currentState, action, count, _tapes);
+    }
+    currentState = program->next(action);
+    _step += count;
     logger.verbose(Logger::Level::Info, constants::RunInformationFormat, //
-                   _indent, step, _indent, currentState, tapes);
+                   _indent, _step, _indent, program->stateName(currentState),
+                   _tapes);
     return Status::Running;
   }
 
-  auto getIndent() const -> std::string_view {
+  auto traceEnd() const -> Trace::End {
+    switch (status) {
+    case Status::Accepted:
+      return Trace::End::Accepted;
+    case Status::Exceeded:
+      return Trace::End::Exceeded;
+    case Status::Looping:
+      return Trace::End::Looping;
+    default:
+      return Trace::End::Stopped;
+    }
+  }
+
+  auto checkLoop() -> Status {
+    if (auto period = loops->check(currentState, _tapes)) {
+      loopPeriod = *period;
+      return Status::Looping;
+    }
+    return Status::Running;
+  }
+
+  // Macro steps cover many steps at once, so the budget is checked every
+  // MacroCheckInterval macro steps and the tape may have run past the step
+  // limit once it is exceeded.
+  auto runMacro(const Budget &budget) -> Status {
+    auto blockSize = options.blockSize == 0
+                         ? MacroMachine::chooseBlockSize(program, input)
+                         : std::min(options.blockSize,
+                                    MacroMachine::maxBlockSize(*program));
+    auto machine = MacroMachine(program, blockSize);
+    machine.load(input);
+    auto halt = MacroMachine::Halt::Running;
+    auto exceeded = false;
+    while (halt == MacroMachine::Halt::Running && !exceeded) {
+      halt = machine.run(budget, MacroCheckInterval);
+      exceeded = halt == MacroMachine::Halt::Running
+                     ? budget.exceeded(machine.steps())
+                     : !budget.allows(machine.steps());
+    }
+    machine.store(_tapes[0]);
+    currentState = machine.currentState();
+    _step = machine.steps();
+    if (_step > 0) {
+      auto _indent = getIndent();
+      logger.verbose(Logger::Level::Info, constants::RunInformationFormat, //
+                     _indent, _step, _indent, program->stateName(currentState),
+                     _tapes);
+    }
+    if (exceeded) {
+      return Status::Exceeded;
+    }
+    return halt == MacroMachine::Halt::Accepted ? Status::Accepted
+                                                : Status::Stopped;
+  }
+
+  auto runThreaded(const Budget &budget) -> Status {
+    if (!threaded) {
+      threaded = std::make_shared<const ThreadedMachine>(program);
+    }
+    auto outcome = threaded->run(input, _tapes, budget);
+    currentState = outcome.state;
+    _step = outcome.steps;
+    if (_step > 0) {
+      auto _indent = getIndent();
+      logger.verbose(Logger::Level::Info, constants::RunInformationFormat, //
+                     _indent, _step, _indent, program->stateName(currentState),
+                     _tapes);
+    }
+    switch (outcome.halt) {
+    case ThreadedMachine::Halt::Accepted:
+      return Status::Accepted;
+    case ThreadedMachine::Halt::Exceeded:
+      return Status::Exceeded;
+    default:
+      return Status::Stopped;
+    }
+  }
+
+  auto runExplorer(const Budget &budget) -> Status {
+    if (!explorer) {
+      return Status::Stopped;
+    }
+    auto outcome = explorer->run(input, budget);
+    _tapes = std::move(outcome.tapes);
+    currentState = outcome.state;
+    _step = outcome.steps;
+    if (_step > 0) {
+      auto _indent = getIndent();
+      logger.verbose(Logger::Level::Info, constants::RunInformationFormat, //
+                     _indent, _step, _indent, program->stateName(currentState),
+                     _tapes);
+    }
+    switch (outcome.halt) {
+    case Explorer::Halt::Accepted:
+      return Status::Accepted;
+    case Explorer::Halt::Exceeded:
+      return Status::Exceeded;
+    default:
+      return Status::Stopped;
+    }
+  }
+
+  // A transition that loops on its own state fires again as long as every
+  // moving head keeps reading the same symbol and every other head reads
+  // back what it wrote, so the whole run can be applied at once.
+  auto sweepLength(ActionId action) const -> Size {
+    if (program->next(action) != currentState) {
+      return 1;
+    }
+    auto output = program->output(action);
+    auto moves = program->move(action);
+    auto count = SweepLimit;
+    auto moving = false;
+    for (auto i = Size{0}; i < _tapes.size(); i++) {
+      auto symbol = _tapes[i].read();
+      if (moves[i] == Move::Stay) {
+        if (output[i] != symbol && output[i] != Transition::Wildcard) {
+          return 1;
+        }
+        continue;
+      }
+      moving = true;
+      count = std::min(count, _tapes[i].runLength(moves[i], symbol, count));
+    }
+    return moving ? count : 1;
+  }
+
+  auto sweep(ActionId action, Size count) -> void {
+    auto output = program->output(action);
+    auto moves = program->move(action);
+    for (auto i = Size{0}; i < _tapes.size(); i++) {
+      if (moves[i] != Move::Stay) {
+        _tapes[i].sweep(output[i], moves[i], count);
+      }
+    }
+  }
+
+  auto getIndent() const -> std::string_view { return indent; }
+
+public:
+  // Padding that lines the fields of a configuration up with the tapes.
+  static auto indentOf(Size tapeCount) -> std::string {
     auto n = 0;
-    auto tapeCount = turingState.tapeCount;
     while (tapeCount > 0) {
       tapeCount /= 10;
       n++;
     }
-    static auto indent = std::string(n, ' ');
-    return indent;
+    return std::string(n, ' ');
   }
 };
 } // namespace turing::simulator
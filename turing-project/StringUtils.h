@@ -1,5 +1,8 @@
 #pragma once
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <optional>
 #include <regex>
 #include <sstream>
 #include <tuple>
@@ -143,32 +146,46 @@ inline auto join(const V &vec, char delim) -> std::string {
   return join(vec, std::string_view(&delim, 1));
 }
 
+// Appends fmt to out with every "{}" replaced by the next argument, so that
+// repeated messages can reuse one buffer.
 template <StringConvertible... Args>
-auto format(std::string_view fmt, Args &&...args) -> std::string {
+auto formatTo(std::string &out, std::string_view fmt, Args &&...args) -> void {
   if constexpr (sizeof...(args) == 0) {
-    return std::string{fmt};
+    out.append(fmt);
+  } else {
+    auto strArgs = std::array<std::string, sizeof...(args)>{
+        toString(std::forward<Args>(args))...};
+    for (auto i = std::size_t{0};; i++) {
+      auto pos = fmt.find("{}");
+      if (pos == std::string_view::npos) {
+        out.append(fmt);
+        return;
+      }
+      out.append(fmt.substr(0, pos));
+      if (i < strArgs.size()) {
+        out.append(strArgs[i]);
+      }
+      fmt.remove_prefix(pos + 2);
+    }
   }
+}
 
-  auto is = std::ostringstream{};
-  auto tupArgs = std::make_tuple(std::forward<Args>(args)...);
-  auto vecArgs = std::vector<std::string>{};
-
-  std::apply(
-      [&vecArgs](auto &&...args) {
-        (vecArgs.emplace_back(toString(args)), ...);
-      },
-      tupArgs);
-
-  auto fmtVec = split(fmt, "{}");
-  auto fmtSize = fmtVec.size();
-  auto argSize = sizeof...(args);
-  for (auto i = 0; i < fmtSize; ++i) {
-    is << fmtVec[i];
-    if (i < argSize && i != fmtSize - 1) {
-      is << vecArgs[i];
-    }
+template <StringConvertible... Args>
+auto format(std::string_view fmt, Args &&...args) -> std::string {
+  auto out = std::string{};
+  formatTo(out, fmt, std::forward<Args>(args)...);
+  return out;
+}
+
+template <typename T>
+  requires std::is_integral_v<T>
+inline auto toNumber(std::string_view s) -> std::optional<T> {
+  auto value = T{};
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc{} || end != s.data() + s.size()) {
+    return std::nullopt;
   }
-  return is.str();
+  return value;
 }
 
 inline auto trim(std::string_view s, char symbol = ' ') -> std::string_view {
@@ -1,18 +1,67 @@
 #pragma once
 #include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <unordered_map>
 
 #include <Machine.h>
 #include <StringUtils.h>
 
 namespace turing::machine {
+
+using Hash = std::uint64_t;
+
 struct Tape {
+public:
+  enum class Storage {
+    Contiguous, // one buffer spanning every visited cell
+    Paged,      // fixed-size pages, only allocated once written non-blank
+  };
+
+  static constexpr auto PageBits = 12;
+  static constexpr auto PageSize = Position{1} << PageBits;
+  // A contiguous tape switches to pages once its span would grow past this.
+  static constexpr auto PagedSpanThreshold = Position{1} << 24;
+
 private:
-  Size index;
-  Symbols tape;
-  Position _start; // Offset of logical position and real position
+  using Pages = std::unordered_map<Position, Symbols>;
+
+  // Remembers the page under the head, or that it is not allocated. Copies
+  // start cold, since the cached pointer refers to the original pages.
+  struct PageCache {
+    bool valid = false;
+    Position page = 0;
+    Symbol *cells = nullptr;
+
+    PageCache() = default;
+    PageCache(const PageCache &) {}
+    auto operator=(const PageCache &) -> PageCache & {
+      valid = false;
+      return *this;
+    }
+  };
+
+  // What a step reads and writes comes first, so that it sits in one cache
+  // line of every tape.
   Position _head;  // Write _head
+  Position _start; // Offset of logical position and real position
+  Symbols tape;
+  Storage storage;
   Symbol blank;
 
+  // Zobrist-style hash of the cells: the XOR of one key per non-blank cell,
+  // drawn from its tape, position and symbol. Blank cells contribute
+  // nothing, so growing the tape leaves it unchanged, and a write only
+  // swaps the key of one cell. Kept up to date only while tracking.
+  bool tracking = false;
+  Hash cellsHash = 0;
+
+  Size index;
+  Pages pages;
+  mutable PageCache cache;
+
   static constexpr auto FormatTemplate = "Index{}{} : {}\n"
                                          "Tape{}{}  : {}\n"
                                          "Head{}{}  : {}";
@@ -20,24 +69,35 @@ private:
   std::string indent;
 
 public:
-  Tape(Size index, const TuringState &state)
-      : index(index), tape(1, state.blankSymbol), _start(0), _head(0),
-        blank(state.blankSymbol) {
-    indent = std::string(getLength(state.tapeCount) - getLength(index), ' ');
+  Tape(Size index, Size tapeCount, Symbol blank)
+      : _head(0), _start(0), tape(1, blank), storage(Storage::Contiguous),
+        blank(blank), index(index) {
+    indent = std::string(getLength(tapeCount) - getLength(index), ' ');
   }
 
-  Tape(Size index, const TuringState &state, SymbolsRef tape)
-      : index(index), tape(tape), _start(0), _head(0),
-        blank(state.blankSymbol) {
-    indent = std::string(getLength(state.tapeCount) - getLength(index), ' ');
+  Tape(Size index, Size tapeCount, Symbol blank, SymbolsRef tape)
+      : _head(0), _start(0), tape(tape), storage(Storage::Contiguous),
+        blank(blank), index(index) {
+    indent = std::string(getLength(tapeCount) - getLength(index), ' ');
   }
 
+  Tape(Size index, const TuringState &state)
+      : Tape(index, state.tapeCount, state.blankSymbol) {}
+
+  Tape(Size index, const TuringState &state, SymbolsRef tape)
+      : Tape(index, state.tapeCount, state.blankSymbol, tape) {}
+
   auto offset(Position pos) const -> Position { return pos - start(); }
   auto head() const -> Position { return _head; }
   auto start() const -> Position { return _start; }
   auto stop() const -> Position { return _start + tape.size(); }
+  auto mode() const -> Storage { return storage; }
 
   auto at(Position pos) const -> Symbol {
+    if (storage == Storage::Paged) {
+      auto *cells = findPage(pos >> PageBits);
+      return cells == nullptr ? blank : cells[pos & (PageSize - 1)];
+    }
     if (pos < start() || pos >= stop()) {
       return blank;
     }
@@ -45,11 +105,27 @@ public:
   }
 
   auto at(Position pos) -> Symbol & {
+    if (storage == Storage::Paged) {
+      return pageAt(pos);
+    }
+    // grow by at least the current size so that sweeping in either direction
+    // costs amortized O(1) per cell
+    auto size = static_cast<Position>(tape.size());
+    auto grow = Position{0};
+    if (pos < start()) {
+      grow = std::max(start() - pos, size);
+    } else if (pos >= stop()) {
+      grow = std::max(pos - stop() + 1, size);
+    }
+    if (grow > 0 && size + grow > PagedSpanThreshold) {
+      usePages();
+      return pageAt(pos);
+    }
     if (pos < start()) {
-      tape.insert(tape.begin(), start() - pos, blank);
-      _start = pos;
+      tape.insert(tape.begin(), grow, blank);
+      _start -= grow;
     } else if (pos >= stop()) {
-      tape.insert(tape.end(), pos - stop() + 1, blank);
+      tape.append(grow, blank);
     }
     return tape[offset(pos)];
   }
@@ -58,18 +134,193 @@ public:
   auto operator[](Position pos) -> Symbol & { return at(pos); }
 
   auto write(Symbol symbol, Move move) -> Position {
-    (*this)[head()] = symbol;
+    // the common case, a symbol written inside a contiguous buffer
+    if (auto *cell = storedCell(); cell != nullptr && !tracking &&
+                                   symbol != Transition::Wildcard) {
+      *cell = symbol;
+      _head += static_cast<Position>(move);
+      return head();
+    }
+    // blanks written over untouched pages leave them unallocated
+    if (symbol != Transition::Wildcard &&
+        (storage == Storage::Contiguous || symbol != blank ||
+         findPage(head() >> PageBits) != nullptr)) {
+      auto &cell = (*this)[head()];
+      if (tracking) {
+        cellsHash ^= cellKey(head(), cell) ^ cellKey(head(), symbol);
+      }
+      cell = symbol;
+    }
     _head += static_cast<Position>(move);
     return head();
   }
 
-  auto read() const -> Symbol { return at(head()); }
+  // Undoes a write that moved the head by move over a cell holding symbol.
+  auto unwrite(Symbol symbol, Move move) -> void {
+    _head -= static_cast<Position>(move);
+    write(symbol, Move::Stay);
+  }
+
+  auto read() const -> Symbol {
+    const auto *cell = storedCell();
+    return cell != nullptr ? *cell : at(head());
+  }
+
+  // Number of consecutive cells holding symbol, starting at the head and
+  // walking towards move, capped at limit.
+  auto runLength(Move move, Symbol symbol, Size limit) const -> Size {
+    auto step = static_cast<Position>(move);
+    auto count = Size{0};
+    auto pos = head();
+    if (storage == Storage::Paged) {
+      for (; count < limit && at(pos) == symbol; count++) {
+        pos += step;
+      }
+      return count;
+    }
+    while (count < limit) {
+      auto left = static_cast<Position>(std::min<Size>(
+          limit - count, std::numeric_limits<Position>::max()));
+      if (pos >= start() && pos < stop()) {
+        auto cells = step > 0 ? stop() - pos : pos - start() + 1;
+        auto span = static_cast<Size>(std::min(cells, left));
+        auto same = step > 0 ? sameRight(&tape[offset(pos)], span, symbol)
+                             : sameLeft(&tape[offset(pos)], span, symbol);
+        count += same;
+        pos += static_cast<Position>(same) * step;
+        if (same < span) {
+          break;
+        }
+      } else if (symbol != blank) {
+        break;
+      } else if ((pos < start()) == (step < 0)) {
+        count = limit; // blanks all the way
+      } else {
+        auto cells = step > 0 ? start() - pos : pos - stop() + 1;
+        count += std::min(cells, left);
+        pos += std::min(cells, left) * step;
+      }
+    }
+    return count;
+  }
+
+  // Writes symbol over count cells starting at the head while moving, as
+  // count calls to write() would.
+  auto sweep(Symbol symbol, Move move, Size count) -> Position {
+    auto step = static_cast<Position>(move);
+    auto last = head() + static_cast<Position>(count - 1) * step;
+    if (storage == Storage::Contiguous && symbol != Transition::Wildcard) {
+      at(last);
+      at(head());
+      // growing may have switched the tape to pages
+      if (storage == Storage::Contiguous) {
+        auto first = std::min(head(), last);
+        if (tracking) {
+          for (auto pos = first; pos < first + static_cast<Position>(count);
+               pos++) {
+            cellsHash ^= cellKey(pos, tape[offset(pos)]) ^ cellKey(pos, symbol);
+          }
+        }
+        std::fill_n(tape.begin() + offset(first), count, symbol);
+        _head = last + step;
+        return head();
+      }
+    }
+    for (auto i = Size{0}; i < count; i++) {
+      write(symbol, move);
+    }
+    return head();
+  }
+
+  // Replaces the whole tape with cells laid out from start on.
+  auto load(SymbolsRef cells, Position start, Position head) -> void {
+    storage = Storage::Contiguous;
+    pages.clear();
+    cache = PageCache{};
+    if (cells.empty()) {
+      tape.assign(1, blank);
+    } else {
+      tape.assign(cells);
+    }
+    _start = start;
+    _head = head;
+    if (static_cast<Position>(tape.size()) > PagedSpanThreshold) {
+      usePages();
+    }
+    if (tracking) {
+      cellsHash = hashCells();
+    }
+  }
+
+  // Calls visit(first, cells) for every stored run of cells, the whole
+  // buffer of a contiguous tape or each page. Nothing is allocated, so it is
+  // safe in a forked child.
+  template <typename Visit> auto visitCells(Visit &&visit) const -> void {
+    if (storage == Storage::Contiguous) {
+      visit(start(), SymbolsRef{tape});
+      return;
+    }
+    for (const auto &[page, cells] : pages) {
+      visit(page << PageBits, SymbolsRef{cells});
+    }
+  }
+
+  // Bytes held for the cells, by the buffer of a contiguous tape or by its
+  // pages. A tape gives nothing back while it runs, so this is the most it
+  // has held since it switched to pages, if it did.
+  auto footprint() const -> Size {
+    if (storage == Storage::Contiguous) {
+      return tape.capacity();
+    }
+    return pages.size() * static_cast<Size>(PageSize);
+  }
+
+  // Puts cells on the tape from position first on, growing it as writes
+  // would.
+  auto place(Position first, SymbolsRef cells) -> void {
+    for (auto i = Size{0}; i < cells.size(); i++) {
+      at(first + static_cast<Position>(i)) = cells[i];
+    }
+    if (tracking) {
+      cellsHash = hashCells();
+    }
+  }
+
+  // Keeps the hash of the cells up to date from now on, at O(1) per write.
+  auto trackHash() -> void {
+    if (!tracking) {
+      tracking = true;
+      cellsHash = hashCells();
+    }
+  }
+
+  // Hash of the cells and the head position. Without tracking it is worked
+  // out from every cell.
+  auto hash() const -> Hash {
+    return (tracking ? cellsHash : hashCells()) ^
+           mix(static_cast<Hash>(head()) ^ mix(Hash{index} ^ HeadSeed));
+  }
+
+  // Moves the cells into pages, keeping only the pages that hold a non-blank
+  // symbol. Untouched regions between far apart heads then cost nothing.
+  auto usePages() -> void {
+    if (storage == Storage::Paged) {
+      return;
+    }
+    storage = Storage::Paged;
+    for (auto pos = start(); pos < stop(); pos++) {
+      if (auto symbol = tape[offset(pos)]; symbol != blank) {
+        pageAt(pos) = symbol;
+      }
+    }
+    tape = Symbols{};
+    _start = 0;
+  }
 
   auto toString() const -> std::string {
-    auto startRealPos = static_cast<int>(tape.find_first_not_of(blank));
-    auto stopRealPos = static_cast<int>(tape.find_last_not_of(blank));
+    auto first = firstSymbol();
 
-    if (startRealPos == -1) {
+    if (!first) {
       auto line = std::array<std::string, 3>{
           utils::toString(std::abs(head())),
           utils::toString(blank),
@@ -83,19 +334,18 @@ public:
                            index, indent, std::move(line[2]));
     }
 
+    auto startPos = std::min(*first, head());
+    auto stopPos = std::max(*lastSymbol(), head());
+
     auto indexString = std::vector<std::string>{};
     auto tapeString = std::vector<std::string>{};
     auto headString = std::vector<std::string>{};
 
-    indexString.reserve(stopRealPos - startRealPos + 1);
-    tapeString.reserve(stopRealPos - startRealPos + 1);
-    headString.reserve(stopRealPos - startRealPos + 1);
+    indexString.reserve(stopPos - startPos + 1);
+    tapeString.reserve(stopPos - startPos + 1);
+    headString.reserve(stopPos - startPos + 1);
 
-    startRealPos = std::min(startRealPos, offset(head()));
-    stopRealPos = std::max(stopRealPos, offset(head()));
-
-    for (auto i = startRealPos; i <= stopRealPos; i++) {
-      auto logicalPos = i + start();
+    for (auto logicalPos = startPos; logicalPos <= stopPos; logicalPos++) {
       auto symbol = at(logicalPos);
       auto line = std::array<std::string, 3>{
           utils::toString(std::abs(logicalPos)),
@@ -114,20 +364,200 @@ public:
                          index, indent, utils::join(headString));
   }
 
-  auto setIndex(Size newIndex) -> void { index = newIndex; }
+  auto setIndex(Size newIndex) -> void {
+    index = newIndex;
+    if (tracking) {
+      cellsHash = hashCells();
+    }
+  }
 
   auto result() const -> std::string {
-    auto startRealPos = static_cast<int>(tape.find_first_not_of(blank));
-    auto stopRealPos = static_cast<int>(tape.find_last_not_of(blank));
-
-    if (startRealPos == -1) {
+    auto first = firstSymbol();
+    if (!first) {
       return "";
     }
+    auto last = *lastSymbol();
+    if (storage == Storage::Contiguous) {
+      return tape.substr(offset(*first), last - *first + 1);
+    }
+    auto ret = std::string{};
+    ret.reserve(last - *first + 1);
+    for (auto pos = *first; pos <= last; pos++) {
+      ret.push_back(at(pos));
+    }
+    return ret;
+  }
+
+  // Logical positions of the leftmost and rightmost non-blank symbols.
+  auto firstSymbol() const -> std::optional<Position> {
+    return findSymbol(true);
+  }
 
-    return tape.substr(startRealPos, stopRealPos - startRealPos + 1);
+  auto lastSymbol() const -> std::optional<Position> {
+    return findSymbol(false);
   }
 
 private:
+  // The cell under the head when it lies in the contiguous buffer, found
+  // with a single comparison.
+  auto storedCell() -> Symbol * {
+    auto offset = static_cast<Size>(_head - _start);
+    return storage == Storage::Contiguous && offset < tape.size()
+               ? &tape[offset]
+               : nullptr;
+  }
+
+  auto storedCell() const -> const Symbol * {
+    return const_cast<Tape *>(this)->storedCell();
+  }
+
+  auto findSymbol(bool first) const -> std::optional<Position> {
+    if (storage == Storage::Contiguous) {
+      auto pos = first ? tape.find_first_not_of(blank)
+                       : tape.find_last_not_of(blank);
+      if (pos == Symbols::npos) {
+        return std::nullopt;
+      }
+      return start() + static_cast<Position>(pos);
+    }
+
+    auto order = std::vector<Position>{};
+    order.reserve(pages.size());
+    for (const auto &[page, cells] : pages) {
+      order.push_back(page);
+    }
+    if (first) {
+      std::sort(order.begin(), order.end());
+    } else {
+      std::sort(order.begin(), order.end(), std::greater<>{});
+    }
+    for (auto page : order) {
+      const auto &cells = pages.at(page);
+      auto pos = first ? cells.find_first_not_of(blank)
+                       : cells.find_last_not_of(blank);
+      if (pos != Symbols::npos) {
+        return (page << PageBits) + static_cast<Position>(pos);
+      }
+    }
+    return std::nullopt;
+  }
+
+  static constexpr auto HeadSeed = Hash{0x5bd1e9955bd1e995};
+
+  // splitmix64 finalizer
+  static auto mix(Hash x) -> Hash {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  }
+
+  auto cellKey(Position pos, Symbol symbol) const -> Hash {
+    if (symbol == blank) {
+      return 0;
+    }
+    // every bit of the position counts, however wide it is
+    return mix(static_cast<Hash>(pos) ^
+               mix(Hash{index} << 8 ^
+                   static_cast<Hash>(static_cast<unsigned char>(symbol))));
+  }
+
+  auto hashCells() const -> Hash {
+    auto hash = Hash{0};
+    if (storage == Storage::Contiguous) {
+      for (auto pos = start(); pos < stop(); pos++) {
+        hash ^= cellKey(pos, tape[offset(pos)]);
+      }
+      return hash;
+    }
+    for (const auto &[page, cells] : pages) {
+      for (auto i = Position{0}; i < PageSize; i++) {
+        hash ^= cellKey((page << PageBits) + i, cells[i]);
+      }
+    }
+    return hash;
+  }
+
+  auto findPage(Position page) const -> Symbol * {
+    if (cache.valid && cache.page == page) {
+      return cache.cells;
+    }
+    auto it = pages.find(page);
+    cache.valid = true;
+    cache.page = page;
+    cache.cells = it == pages.end() ? nullptr
+                                    : const_cast<Symbol *>(it->second.data());
+    return cache.cells;
+  }
+
+  auto pageAt(Position pos) -> Symbol & {
+    auto page = pos >> PageBits;
+    auto *cells = findPage(page);
+    if (cells == nullptr) {
+      cells = pages.try_emplace(page, PageSize, blank).first->second.data();
+      cache.cells = cells;
+    }
+    return cells[pos & (PageSize - 1)];
+  }
+
+  // Length of the prefix of [cells, cells + n) equal to symbol. Compares a
+  // machine word at a time, like memchr does for the opposite question.
+  static auto sameRight(const Symbol *cells, Size n, Symbol symbol) -> Size {
+    auto pattern = broadcast(symbol);
+    auto i = Size{0};
+    for (; i + sizeof(Word) <= n; i += sizeof(Word)) {
+      if (auto diff = load(cells + i) ^ pattern; diff != 0) {
+        return i + firstByte(diff);
+      }
+    }
+    for (; i < n && cells[i] == symbol; i++) {
+    }
+    return i;
+  }
+
+  // Length of the suffix of (cells - n, cells] equal to symbol.
+  static auto sameLeft(const Symbol *cells, Size n, Symbol symbol) -> Size {
+    auto pattern = broadcast(symbol);
+    auto i = Size{0};
+    for (; i + sizeof(Word) <= n; i += sizeof(Word)) {
+      auto diff = load(cells - i - (sizeof(Word) - 1)) ^ pattern;
+      if (diff != 0) {
+        return i + lastByte(diff);
+      }
+    }
+    for (; i < n && *(cells - i) == symbol; i++) {
+    }
+    return i;
+  }
+
+  using Word = std::uint64_t;
+
+  static auto broadcast(Symbol symbol) -> Word {
+    return Word{0x0101010101010101} * static_cast<unsigned char>(symbol);
+  }
+
+  static auto load(const Symbol *cells) -> Word {
+    auto word = Word{};
+    std::memcpy(&word, cells, sizeof(Word));
+    return word;
+  }
+
+  // Index of the lowest and highest addressed non-zero byte of a word.
+  static auto firstByte(Word word) -> Size {
+    if constexpr (std::endian::native == std::endian::little) {
+      return std::countr_zero(word) / 8;
+    } else {
+      return std::countl_zero(word) / 8;
+    }
+  }
+
+  static auto lastByte(Word word) -> Size {
+    if constexpr (std::endian::native == std::endian::little) {
+      return std::countl_zero(word) / 8;
+    } else {
+      return std::countr_zero(word) / 8;
+    }
+  }
+
   static auto getLength(int n) -> int {
     if (n == 0) {
       return 1;
@@ -158,17 +588,20 @@ public:
     }
   }
 
-  Tapes(const TuringState &state, SymbolsRef first) {
-    tapes.reserve(state.tapeCount);
-    for (auto i = 0; i < state.tapeCount; i++) {
+  Tapes(Size tapeCount, Symbol blank, SymbolsRef first) {
+    tapes.reserve(tapeCount);
+    for (auto i = 0; i < tapeCount; i++) {
       if (i == 0) {
-        tapes.emplace_back(i, state, first);
+        tapes.emplace_back(i, tapeCount, blank, first);
       } else {
-        tapes.emplace_back(i, state);
+        tapes.emplace_back(i, tapeCount, blank);
       }
     }
   }
 
+  Tapes(const TuringState &state, SymbolsRef first)
+      : Tapes(state.tapeCount, state.blankSymbol, first) {}
+
   explicit Tapes(const TuringState &state) {
     tapes.reserve(state.tapeCount);
     for (auto i = 0; i < state.tapeCount; i++) {
@@ -176,21 +609,36 @@ public:
     }
   }
 
-  auto read() const -> Symbols {
-    auto symbols = Symbols{};
-    symbols.reserve(tapes.size());
-    std::transform(tapes.begin(), tapes.end(), std::back_inserter(symbols),
-                   [](const auto &tape) { return tape.read(); });
-    return symbols;
+  // Symbols under the heads, in heads, which the caller keeps so that const
+  // tapes can be read from several threads.
+  auto read(Symbols &heads) const -> SymbolsRef {
+    heads.resize(tapes.size());
+    for (auto i = Size{0}; i < tapes.size(); i++) {
+      heads[i] = tapes[i].read();
+    }
+    return heads;
   }
 
-  auto write(SymbolsRef symbols, MovesRef moves) -> std::vector<Position> {
-    auto heads = std::vector<Position>{};
-    heads.reserve(tapes.size());
-    for (auto i = 0; i < tapes.size(); i++) {
-      heads.emplace_back(tapes[i].write(symbols[i], moves[i]));
+  auto write(SymbolsRef symbols, MovesRef moves) -> void {
+    for (auto i = Size{0}; i < tapes.size(); i++) {
+      tapes[i].write(symbols[i], moves[i]);
+    }
+  }
+
+  // Undoes write(..., moves) over cells that held symbols.
+  auto unwrite(SymbolsRef symbols, MovesRef moves) -> void {
+    for (auto i = Size{0}; i < tapes.size(); i++) {
+      tapes[i].unwrite(symbols[i], moves[i]);
+    }
+  }
+
+  auto size() const -> Size { return tapes.size(); }
+
+  // Puts first on the first tape and blanks everywhere else.
+  auto reset(SymbolsRef first) -> void {
+    for (auto i = Size{0}; i < tapes.size(); i++) {
+      tapes[i].load(i == 0 ? first : SymbolsRef{}, 0, 0);
     }
-    return heads;
   }
 
   auto operator[](Size index) -> Tape & { return tapes[index]; }
@@ -202,6 +650,31 @@ public:
   auto end() -> iterator { return tapes.end(); }
   auto end() const -> const_iterator { return tapes.end(); }
 
+  // Starts keeping the hash of every tape up to date, see Tape::trackHash.
+  auto trackHash() -> void {
+    for (auto &tape : tapes) {
+      tape.trackHash();
+    }
+  }
+
+  // Hash of the contents and head positions of every tape.
+  auto hash() const -> Hash {
+    auto hash = Hash{0};
+    for (const auto &tape : tapes) {
+      hash ^= tape.hash();
+    }
+    return hash;
+  }
+
+  // Bytes held for the cells of every tape, see Tape::footprint.
+  auto footprint() const -> Size {
+    auto bytes = Size{0};
+    for (const auto &tape : tapes) {
+      bytes += tape.footprint();
+    }
+    return bytes;
+  }
+
   auto toString() const -> std::string { return utils::join(*this, '\n'); }
   auto result() const -> std::string { return tapes[0].result(); }
 };
@@ -0,0 +1,225 @@
+#pragma once
+#include <memory>
+
+#include <Budget.h>
+#include <Program.h>
+#include <Tape.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// ThreadedMachine runs a Program as threaded code. Every state becomes a
+// record holding its dispatch row, one slot per packed key, and every action
+// a record pointing straight at the record of its next state. A step reads
+// the heads, indexes the row of the current record and follows one pointer,
+// without going back to Program. Cells hold symbol ids, so reading the heads
+// needs no translation either.
+//
+// The records are built once and only read while running, so one machine
+// can be shared by every simulator of the same program.
+struct ThreadedMachine {
+public:
+  enum class Halt { Accepted, Stopped, Exceeded };
+
+  struct Outcome {
+    Halt halt;
+    StateId state;
+    Steps steps;
+  };
+
+  // Every row holds 2^keyBits slots, so the rows of all states together
+  // must stay within the budget of a dense table.
+  static auto supports(const Program &program) -> bool {
+    auto keyBits = cellBits(program) * program.tapes();
+    return program.tableLayout() != Program::Layout::Wide && keyBits < 32 &&
+           program.states() <= (Program::DenseTableLimit >> keyBits);
+  }
+
+private:
+  struct Record;
+
+  struct Action {
+    const Record *next;
+    Size cells; // index of the first of its writes and moves
+  };
+
+  struct Record {
+    const Action *const *row; // nullptr where the machine stops
+    StateId state;
+    bool accepting;
+  };
+
+  // Visited cells of one tape, grown by doubling on the side the head leaves.
+  struct Cells {
+    std::vector<SymbolId> ids;
+    Position head;   // index of the head in ids
+    Position origin; // index of position 0 in ids
+  };
+
+  static constexpr auto Keep = std::int16_t{-1}; // written by a wildcard
+
+  std::shared_ptr<const Program> program;
+  Size tapeCount;
+  Size symbolBits;
+  std::vector<Record> records;
+  std::vector<const Action *> rows;
+  std::vector<Action> actions;
+  std::vector<std::int16_t> writes;
+  std::vector<Position> moves;
+
+public:
+  explicit ThreadedMachine(std::shared_ptr<const Program> program)
+      : program(std::move(program)), tapeCount(this->program->tapes()),
+        symbolBits(cellBits(*this->program)) {
+    const auto &p = *this->program;
+    auto keys = Key{1} << (symbolBits * tapeCount);
+    records.resize(p.states());
+    actions.resize(p.actions());
+    rows.assign(p.states() * keys, nullptr);
+    writes.reserve(p.actions() * tapeCount);
+    moves.reserve(p.actions() * tapeCount);
+
+    for (auto action = ActionId{0}; action < p.actions(); action++) {
+      actions[action] = {&records[p.next(action)], writes.size()};
+      auto output = p.output(action);
+      for (auto i = Size{0}; i < tapeCount; i++) {
+        writes.push_back(output[i] == Transition::Wildcard
+                             ? Keep
+                             : std::int16_t{p.symbolId(output[i])});
+        moves.push_back(static_cast<Position>(p.move(action)[i]));
+      }
+    }
+
+    // keys of symbols that do not exist are never read, their slots stay
+    // empty
+    for (auto state = StateId{0}; state < p.states(); state++) {
+      auto *row = &rows[state * keys];
+      records[state] = {row, state, p.accepts(state)};
+      for (auto key = Key{0}; key < keys; key++) {
+        if (isKey(key)) {
+          auto action = p.find(state, key);
+          row[key] = action == Program::NoAction ? nullptr : &actions[action];
+        }
+      }
+    }
+  }
+
+  ThreadedMachine(const ThreadedMachine &) = delete;
+  auto operator=(const ThreadedMachine &) -> ThreadedMachine & = delete;
+
+  // Runs input from the initial state until the machine halts or exceeds
+  // budget, and leaves the final tapes in tapes.
+  auto run(SymbolsRef input, Tapes &tapes, const Budget &budget) const
+      -> Outcome {
+    auto cells = std::vector<Cells>(tapeCount);
+    for (auto i = Size{0}; i < tapeCount; i++) {
+      auto symbols = i == 0 ? input : SymbolsRef{};
+      cells[i].ids.resize(std::max<Size>(symbols.size(), 1), 0);
+      for (auto j = Size{0}; j < symbols.size(); j++) {
+        cells[i].ids[j] = program->symbolId(symbols[j]);
+      }
+      cells[i].head = 0;
+      cells[i].origin = 0;
+    }
+
+    const auto *record = &records[program->initialState()];
+    auto steps = Steps{0};
+    auto halt = std::optional<Halt>{};
+    while (!halt) {
+      // the tape count of the common machines is known at compile time
+      auto checkpoint = budget.checkpoint(steps);
+      switch (tapeCount) {
+      case 1:
+        halt = loop<1>(cells, record, steps, checkpoint);
+        break;
+      case 2:
+        halt = loop<2>(cells, record, steps, checkpoint);
+        break;
+      case 3:
+        halt = loop<3>(cells, record, steps, checkpoint);
+        break;
+      default:
+        halt = loop<0>(cells, record, steps, checkpoint);
+        break;
+      }
+      if (!halt && budget.exceeded(steps)) {
+        halt = Halt::Exceeded;
+      }
+    }
+
+    for (auto i = Size{0}; i < tapeCount; i++) {
+      auto symbols = Symbols(cells[i].ids.size(), program->blankSymbol());
+      for (auto j = Size{0}; j < symbols.size(); j++) {
+        symbols[j] = program->symbol(cells[i].ids[j]);
+      }
+      tapes[i].load(symbols, -cells[i].origin,
+                    cells[i].head - cells[i].origin);
+    }
+    return {*halt, record->state, steps};
+  }
+
+private:
+  static auto cellBits(const Program &program) -> Size {
+    return std::max<Size>(std::bit_width(program.symbols() - 1), 1);
+  }
+
+  auto isKey(Key key) const -> bool {
+    auto mask = (Key{1} << symbolBits) - 1;
+    for (auto i = Size{0}; i < tapeCount; i++) {
+      if (((key >> (i * symbolBits)) & mask) >= program->symbols()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Steps until the machine halts, or stops short of taking more than
+  // checkpoint steps. N is the tape count, or 0 when it is only known at run
+  // time.
+  template <Size N>
+  auto loop(std::vector<Cells> &cells, const Record *&record, Steps &steps,
+            Steps checkpoint) const -> std::optional<Halt> {
+    const auto tapes = N == 0 ? tapeCount : N;
+    while (!record->accepting) {
+      auto key = Key{0};
+      for (auto i = Size{0}; i < tapes; i++) {
+        key |= Key{cells[i].ids[cells[i].head]} << (i * symbolBits);
+      }
+      const auto *action = record->row[key];
+      if (action == nullptr) {
+        return Halt::Stopped;
+      }
+      if (steps == checkpoint) {
+        return std::nullopt;
+      }
+      for (auto i = Size{0}; i < tapes; i++) {
+        auto &tape = cells[i];
+        if (auto write = writes[action->cells + i]; write != Keep) {
+          tape.ids[tape.head] = static_cast<SymbolId>(write);
+        }
+        tape.head += moves[action->cells + i];
+        if (tape.head < 0 ||
+            tape.head == static_cast<Position>(tape.ids.size())) {
+          grow(tape);
+        }
+      }
+      record = action->next;
+      steps++;
+    }
+    return Halt::Accepted;
+  }
+
+  static auto grow(Cells &tape) -> void {
+    auto size = tape.ids.size();
+    if (tape.head < 0) {
+      tape.ids.insert(tape.ids.begin(), size, 0);
+      tape.head += static_cast<Position>(size);
+      tape.origin += static_cast<Position>(size);
+    } else {
+      tape.ids.resize(size * 2, 0);
+    }
+  }
+};
+
+} // namespace turing::simulator
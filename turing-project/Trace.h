@@ -0,0 +1,310 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include <Errors.h>
+#include <MappedFile.h>
+#include <Program.h>
+
+namespace turing::simulator {
+
+using namespace machine;
+
+// Trace is a run recorded step by step, read back from a trace file. The file
+// starts with a header holding everything needed to replay the run: the
+// states, the actions of the program (next state, symbols written and moves)
+// and the input. Every step then takes one varint, the action it fired, so
+// the tapes are rebuilt by applying the actions in turn. An end record with
+// the outcome closes the file; a run cut short leaves it out.
+//
+//   magic  version  tapes  blank  states {length name}  initial
+//   actions {next outputs moves}  length input  {action}  [end outcome period]
+//
+// Numbers are LEB128 varints, moves are stored as move + 1.
+struct Trace {
+public:
+  static constexpr auto Magic =
+      std::array<char, 8>{'T', 'U', 'R', 'I', 'N', 'G', 'T', 'R'};
+  static constexpr auto Version = std::uint64_t{1};
+
+  enum class End : std::uint8_t { Accepted, Stopped, Exceeded, Looping };
+
+  // Walks the recorded actions in order.
+  struct Cursor {
+  private:
+    std::span<const std::byte> bytes;
+    Size at = 0;
+
+  public:
+    explicit Cursor(std::span<const std::byte> bytes) : bytes(bytes) {}
+
+    auto next() -> ActionId {
+      return static_cast<ActionId>(*readNumber(bytes, at));
+    }
+  };
+
+private:
+  std::shared_ptr<const utils::MappedFile> file;
+  Size tapeCount = 0;
+  Symbol blank = '_';
+  std::vector<std::string_view> stateNames;
+  StateId initial = 0;
+  std::vector<StateId> nextStates;
+  std::string outputs; // symbols written by every action, back to back
+  Moves moves;
+  std::string_view inputSymbols;
+  std::span<const std::byte> records;
+  Steps stepCount = 0;
+  std::optional<End> outcome;
+  Steps loopPeriod = 0;
+
+public:
+  static auto load(utils::MappedFile mapped) -> utils::Result<Trace> {
+    auto trace = Trace{};
+    trace.file = std::make_shared<const utils::MappedFile>(std::move(mapped));
+    if (!trace.read(trace.file->bytes())) {
+      return utils::TuringError::TraceInvalid;
+    }
+    return trace;
+  }
+
+  auto tapes() const -> Size { return tapeCount; }
+  auto blankSymbol() const -> Symbol { return blank; }
+  auto initialState() const -> StateId { return initial; }
+  auto stateName(StateId state) const -> StateRef { return stateNames[state]; }
+  auto input() const -> SymbolsRef { return inputSymbols; }
+
+  auto next(ActionId action) const -> StateId { return nextStates[action]; }
+
+  auto output(ActionId action) const -> SymbolsRef {
+    return SymbolsRef{outputs}.substr(action * tapeCount, tapeCount);
+  }
+
+  auto move(ActionId action) const -> MovesRef {
+    return MovesRef{moves}.subspan(action * tapeCount, tapeCount);
+  }
+
+  auto steps() const -> Steps { return stepCount; }
+  auto end() const -> std::optional<End> { return outcome; }
+  auto period() const -> Steps { return loopPeriod; }
+
+  auto cursor() const -> Cursor { return Cursor(records); }
+
+  static auto readNumber(std::span<const std::byte> bytes, Size &at)
+      -> std::optional<std::uint64_t> {
+    auto value = std::uint64_t{0};
+    for (auto shift = 0; shift < 64 && at < bytes.size(); shift += 7) {
+      auto byte = static_cast<std::uint8_t>(bytes[at++]);
+      value |= std::uint64_t{byte & 0x7fu} << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  Trace() = default;
+
+  // Checks the whole file once, so that replaying it needs no checks.
+  auto read(std::span<const std::byte> bytes) -> bool {
+    auto at = Size{0};
+    auto number = [&bytes, &at](std::uint64_t limit) -> std::optional<Size> {
+      auto value = readNumber(bytes, at);
+      if (!value || *value >= limit) {
+        return std::nullopt;
+      }
+      return static_cast<Size>(*value);
+    };
+    auto text = [&bytes, &at](Size length) -> std::optional<std::string_view> {
+      if (length > bytes.size() - at) {
+        return std::nullopt;
+      }
+      auto view = std::string_view{
+          reinterpret_cast<const char *>(bytes.data() + at), length};
+      at += length;
+      return view;
+    };
+
+    auto magic = text(Magic.size());
+    if (!magic || !std::equal(magic->begin(), magic->end(), Magic.begin()) ||
+        number(Version + 1) != Version) {
+      return false;
+    }
+    auto tapes = number(Size{1} << 16);
+    auto blankSymbol = text(1);
+    auto states = number(bytes.size());
+    if (!tapes || *tapes == 0 || !blankSymbol || !states || *states == 0) {
+      return false;
+    }
+    tapeCount = *tapes;
+    blank = blankSymbol->front();
+    for (auto state = Size{0}; state < *states; state++) {
+      auto length = number(bytes.size());
+      auto name = length ? text(*length) : std::nullopt;
+      if (!name) {
+        return false;
+      }
+      stateNames.push_back(*name);
+    }
+    auto initialState = number(*states);
+    auto actions = number(bytes.size());
+    if (!initialState || !actions) {
+      return false;
+    }
+    initial = static_cast<StateId>(*initialState);
+
+    for (auto action = Size{0}; action < *actions; action++) {
+      auto next = number(*states);
+      auto output = next ? text(tapeCount) : std::nullopt;
+      auto move = output ? text(tapeCount) : std::nullopt;
+      if (!move) {
+        return false;
+      }
+      nextStates.push_back(static_cast<StateId>(*next));
+      for (auto m : *move) {
+        if (m < 0 || m > 2) {
+          return false;
+        }
+        moves.push_back(static_cast<Move>(m - 1));
+      }
+      outputs.append(*output);
+    }
+
+    auto inputLength = number(bytes.size());
+    auto inputText = inputLength ? text(*inputLength) : std::nullopt;
+    if (!inputText) {
+      return false;
+    }
+    inputSymbols = *inputText;
+
+    auto first = at;
+    auto last = at;
+    while (at < bytes.size()) {
+      auto action = number(*actions + 1);
+      if (!action) {
+        // a run cut short may end in the middle of a record
+        break;
+      }
+      if (*action == *actions) {
+        auto end = number(static_cast<Size>(End::Looping) + 1);
+        auto period = end ? number(~std::uint64_t{0}) : std::nullopt;
+        if (!period || at != bytes.size()) {
+          return false;
+        }
+        outcome = static_cast<End>(*end);
+        loopPeriod = *period;
+        break;
+      }
+      stepCount++;
+      last = at;
+    }
+    records = bytes.subspan(first, last - first);
+    return true;
+  }
+};
+
+// TraceWriter appends the steps of a run to a trace, see Trace. Records
+// collect in a large buffer that is only written out when full, so a step
+// costs a few bytes of memory traffic.
+struct TraceWriter {
+public:
+  static constexpr auto BufferSize = Size{1} << 20;
+
+private:
+  static constexpr auto MaxNumberSize = Size{10};
+
+  std::ostream &os;
+  std::vector<char> buffer;
+  Size used = 0;
+  Size endRecord; // the action id that marks the end
+
+public:
+  TraceWriter(std::ostream &os, const Program &program, SymbolsRef input)
+      : os(os), buffer(BufferSize), endRecord(program.actions()) {
+    put(std::string_view{Trace::Magic.data(), Trace::Magic.size()});
+    putNumber(Trace::Version);
+    putNumber(program.tapes());
+    putByte(program.blankSymbol());
+    putNumber(program.states());
+    for (auto state = StateId{0}; state < program.states(); state++) {
+      auto name = program.stateName(state);
+      putNumber(name.size());
+      put(name);
+    }
+    putNumber(program.initialState());
+    putNumber(program.actions());
+    for (auto action = ActionId{0}; action < program.actions(); action++) {
+      putNumber(program.next(action));
+      put(program.output(action));
+      for (auto move : program.move(action)) {
+        putByte(static_cast<char>(static_cast<int>(move) + 1));
+      }
+    }
+    putNumber(input.size());
+    put(input);
+  }
+
+  TraceWriter(const TraceWriter &) = delete;
+  auto operator=(const TraceWriter &) -> TraceWriter & = delete;
+
+  // Records count steps of the same action.
+  auto step(ActionId action, Steps count = 1) -> void {
+    for (auto i = Steps{0}; i < count; i++) {
+      if (used > BufferSize - MaxNumberSize) {
+        flush();
+      }
+      putNumber(action);
+    }
+  }
+
+  auto finish(Trace::End end, Steps period) -> void {
+    putNumber(endRecord);
+    putNumber(static_cast<std::uint64_t>(end));
+    putNumber(period);
+    flush();
+    os.flush();
+  }
+
+  auto flush() -> void {
+    os.write(buffer.data(), static_cast<std::streamsize>(used));
+    used = 0;
+  }
+
+private:
+  auto putNumber(std::uint64_t value) -> void {
+    if (used > BufferSize - MaxNumberSize) {
+      flush();
+    }
+    while (value >= 0x80) {
+      buffer[used++] = static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    buffer[used++] = static_cast<char>(value);
+  }
+
+  auto putByte(char byte) -> void {
+    if (used == BufferSize) {
+      flush();
+    }
+    buffer[used++] = byte;
+  }
+
+  auto put(std::string_view bytes) -> void {
+    if (bytes.size() > BufferSize - used) {
+      flush();
+    }
+    if (bytes.size() > BufferSize) {
+      os.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+      return;
+    }
+    std::memcpy(buffer.data() + used, bytes.data(), bytes.size());
+    used += bytes.size();
+  }
+};
+
+} // namespace turing::simulator
@@ -1,20 +1,499 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#if __has_include(<sys/wait.h>)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <Batch.h>
+#include <Debugger.h>
+#include <Emitter.h>
 #include <Logger.h>
 #include <Parser.h>
 
+using turing::machine::Emitter;
 using turing::parser::Parser;
+using turing::simulator::Batch;
+using turing::simulator::Debugger;
+using turing::simulator::Engine;
+using turing::simulator::Options;
+using turing::simulator::Simulator;
 using turing::utils::Error;
 using turing::utils::Logger;
+using turing::utils::toNumber;
+using turing::utils::TuringError;
 
-auto main(int argc, char **argv) -> int {
-  auto parser = Parser::fromArgs(argc, argv);
+namespace {
+namespace constants = turing::parser::constants;
+
+constexpr auto Usage =
+    "usage: turing [-v|--verbose] [-h|--help] [--sweep]\n"
+    "              [--engine table|macro|threaded|ntm] [--block-size <k>]\n"
+    "              [--max-steps <n>] [--timeout <seconds>] [--detect-loops]\n"
+    "              [--trace <file>] [--checkpoint <file>]\n"
+    "              [--checkpoint-every <seconds>] [--profile]\n"
+    "              [--profile-json <file>] [--optimize]\n"
+    "              [--layout-profile <file>] <tm> <input>\n"
+    "       turing [options] --resume <file> <tm>\n"
+    "       turing [options] --batch <file|-> [--jobs <n>] <tm>\n"
+    "       turing --compile <out.tmc> <tm>\n"
+    "       turing --dump-optimized <out.tm> <tm>\n"
+    "       turing --emit-cpp <tm>\n"
+    "       turing --native <out> <tm>\n"
+    "       turing debug [--max-steps <n>] [--timeout <seconds>] <tm> <input>\n"
+    "       turing trace-show [--from <n>] [--to <n>] <file>\n\n"
+    "--detect-loops only stops exact repeats of the state, head positions and\n"
+    "tapes; a machine drifting over blanks needs --max-steps or --timeout";
+
+auto exitOnError(const Error &error) -> void {
+  // the file is named where it failed to open, and a missing file is a
+  // mistake on the command line
+  if (error == TuringError::FileUnreadable) {
+    std::exit(1);
+  }
+  Logger::instance().error(error.message());
+  std::exit(error.value());
+}
+
+// Reads the options of the command line, printing the usage on a mistake.
+auto parseArguments(int argc, char **argv) -> Parser {
+  auto &logger = Logger::instance();
+  if (argc < 2) {
+    logger.info(Usage);
+    std::exit(1);
+  }
+
+  auto args = std::vector<std::string_view>(argv + 1, argv + argc);
+  auto filename = std::string_view{};
+  auto input = std::string_view{};
+  auto doHelp = false;
+  auto doVerbose = false;
+  auto engineName = std::string_view{"table"};
+  auto options = Options{};
+  if (args.front() == "trace-show") {
+    options.showTrace = true;
+    args.erase(args.begin());
+  } else if (args.front() == "debug") {
+    options.debug = true;
+    args.erase(args.begin());
+  }
+  for (auto it = args.begin(); it != args.end(); ++it) {
+    auto arg = *it;
+    auto hasValue = std::next(it) != args.end();
+    if (!doVerbose && (arg == "-v" || arg == "--verbose")) {
+      doVerbose = true;
+    } else if (!doHelp && (arg == "-h" || arg == "--help")) {
+      doHelp = true;
+    } else if (arg == "--sweep") {
+      options.sweep = true;
+    } else if (arg == "--engine" && hasValue) {
+      auto engine = engineName = *++it;
+      if (engine == "table") {
+        options.engine = Engine::Table;
+      } else if (engine == "macro") {
+        options.engine = Engine::Macro;
+      } else if (engine == "threaded") {
+        options.engine = Engine::Threaded;
+      } else if (engine == "ntm") {
+        options.engine = Engine::Nondeterministic;
+      } else {
+        logger.error("unknown engine: {}", engine);
+        std::exit(1);
+      }
+    } else if (arg == "--block-size" && hasValue) {
+      auto blockSize = toNumber<std::size_t>(*++it);
+      if (!blockSize || *blockSize == 0) {
+        logger.error("invalid block size: {}", *it);
+        std::exit(1);
+      }
+      options.blockSize = *blockSize;
+    } else if (arg == "--max-steps" && hasValue) {
+      auto maxSteps = toNumber<std::uint64_t>(*++it);
+      // in Options 0 means no limit, so neither limit can be set to 0
+      if (!maxSteps || *maxSteps == 0) {
+        logger.error("invalid step limit: {}", *it);
+        std::exit(1);
+      }
+      options.maxSteps = *maxSteps;
+    } else if (arg == "--timeout" && hasValue) {
+      auto timeout = std::string{*++it};
+      auto *end = static_cast<char *>(nullptr);
+      options.timeout = std::strtod(timeout.c_str(), &end);
+      if (timeout.empty() || *end != '\0' || !(options.timeout > 0)) {
+        logger.error("invalid timeout: {}", timeout);
+        std::exit(1);
+      }
+    } else if (arg == "--detect-loops") {
+      options.detectLoops = true;
+    } else if (arg == "--trace" && hasValue) {
+      options.trace = *++it;
+    } else if (arg == "--checkpoint" && hasValue) {
+      options.checkpoint = *++it;
+    } else if (arg == "--checkpoint-every" && hasValue) {
+      auto every = std::string{*++it};
+      auto *end = static_cast<char *>(nullptr);
+      options.checkpointEvery = std::strtod(every.c_str(), &end);
+      if (every.empty() || *end != '\0' || !(options.checkpointEvery >= 0)) {
+        logger.error("invalid checkpoint interval: {}", every);
+        std::exit(1);
+      }
+    } else if (arg == "--resume" && hasValue) {
+      options.resume = *++it;
+    } else if (arg == "--profile") {
+      options.profile = true;
+    } else if (arg == "--profile-json" && hasValue) {
+      options.profile = true;
+      options.profileJson = *++it;
+    } else if ((arg == "--from" || arg == "--to") && hasValue) {
+      auto step = toNumber<std::uint64_t>(*++it);
+      if (!step) {
+        logger.error("invalid step: {}", *it);
+        std::exit(1);
+      }
+      (arg == "--from" ? options.traceFrom : options.traceTo) = *step;
+    } else if (arg == "--batch" && hasValue) {
+      options.batch = *++it;
+    } else if (arg == "--jobs" && hasValue) {
+      auto jobs = toNumber<std::size_t>(*++it);
+      if (!jobs || *jobs == 0) {
+        logger.error("invalid job count: {}", *it);
+        std::exit(1);
+      }
+      options.jobs = *jobs;
+    } else if (arg == "--optimize") {
+      options.optimize = true;
+    } else if (arg == "--dump-optimized" && hasValue) {
+      options.optimize = true;
+      options.dumpOptimized = *++it;
+    } else if (arg == "--layout-profile" && hasValue) {
+      options.layoutProfile = *++it;
+    } else if (arg == "--compile" && hasValue) {
+      options.compile = *++it;
+    } else if (arg == "--emit-cpp") {
+      options.emitCpp = true;
+    } else if (arg == "--native" && hasValue) {
+      options.native = *++it;
+    } else if (filename.empty()) {
+      filename = arg;
+    } else if (input.empty()) {
+      input = arg;
+    }
+  }
+
+  // batch workers run side by side, their steps cannot be told apart
+  logger.setVerbose(doVerbose && options.batch.empty());
+  if (doVerbose && options.batch.empty()) {
+    // every step prints a configuration, write them on another thread
+    logger.startWriter();
+  }
+  if (doHelp) {
+    logger.info(Usage);
+    std::exit(0);
+  }
+
+  if (options.showTrace) {
+    if (filename.empty()) {
+      logger.error("No trace file specified");
+      std::exit(1);
+    }
+    return std::move(
+        Parser::open(filename, input, options).onError(exitOnError));
+  }
+  if (!filename.ends_with(constants::SourceExtension) &&
+      !filename.ends_with(constants::ImageExtension)) {
+    logger.error("No input file specified");
+    std::exit(1);
+  }
+
+  if (!options.resume.empty() && !options.trace.empty()) {
+    // a trace replays the run from its input
+    logger.error("a resumed run cannot be traced");
+    std::exit(1);
+  }
+  if (options.engine == Engine::Nondeterministic &&
+      (!options.batch.empty() || options.detectLoops ||
+       !options.trace.empty() || !options.checkpoint.empty() ||
+       !options.resume.empty() || options.profile)) {
+    // these follow a single branch, step by step
+    logger.error("the ntm engine runs no batches, loop checks, traces, "
+                 "checkpoints or profiles");
+    std::exit(1);
+  }
+  if (!options.batch.empty()) {
+    options.checkpoint = {};
+    options.resume = {};
+    options.profile = false;
+  }
+
+  // loops, traces, checkpoints and profiles are found, recorded, taken and
+  // counted between single steps of the table engine
+  if (options.engine != Engine::Table &&
+      (options.detectLoops || !options.trace.empty() ||
+       !options.checkpoint.empty() || !options.resume.empty() ||
+       options.profile)) {
+    logger.error("the {} engine runs no loop checks, traces, checkpoints or "
+                 "profiles",
+                 engineName);
+    std::exit(1);
+  }
+  // and verbose output shows every single step
+  if (options.sweep && (doVerbose || options.detectLoops)) {
+    logger.error("--sweep cannot be combined with --verbose or "
+                 "--detect-loops");
+    std::exit(1);
+  }
+  return std::move(
+      Parser::open(filename, input, options).onError(exitOnError));
+}
+
+auto runBatch(Parser &parser) -> int {
   const auto &logger = Logger::instance();
+  const auto &options = parser.runOptions();
+  auto program = parser.program().onError(exitOnError);
+  Simulator::of(program, {}, options).onError(exitOnError);
 
-  auto simulator = parser.parse().onError([&logger](const Error &error) {
-    logger.error(error.message());
-    std::exit(error.value());
+  auto inputs = std::vector<std::string>{};
+  if (options.batch == "-") {
+    inputs = Batch::readInputs(std::cin);
+  } else {
+    auto fs = std::ifstream(std::string{options.batch});
+    if (!fs.is_open()) {
+      logger.error("failed to open file: {}", options.batch);
+      std::exit(1);
+    }
+    inputs = Batch::readInputs(fs);
+  }
+
+  auto results = Batch(program, options).run(inputs);
+  if (!results.empty()) {
+    logger.info(turing::utils::join(results, '\n'));
+  }
+  return 0;
+}
+
+auto compileImage(Parser &parser) -> int {
+  const auto &logger = Logger::instance();
+  auto path = std::string{parser.runOptions().compile};
+  auto program = parser.program().onError(exitOnError);
+  auto fs = std::ofstream(path, std::ios::binary);
+  if (!fs.is_open()) {
+    logger.error("failed to open file: {}", path);
+    std::exit(1);
+  }
+  program->save(fs).onError([&fs, &path](const Error &error) {
+    fs.close();
+    std::remove(path.c_str());
+    exitOnError(error);
   });
+  if (!fs.flush()) {
+    logger.error("failed to write file: {}", path);
+    std::exit(1);
+  }
+  return 0;
+}
+
+// Writes the optimized machine as a source file.
+auto dumpOptimized(Parser &parser) -> int {
+  const auto &logger = Logger::instance();
+  auto path = std::string{parser.runOptions().dumpOptimized};
+  if (auto error = parser.parseSource(); error) {
+    exitOnError(error);
+  }
+  auto fs = std::ofstream(path);
+  if (!fs.is_open()) {
+    logger.error("failed to open file: {}", path);
+    std::exit(1);
+  }
+  fs << parser.machine().toSource();
+  if (!fs.flush()) {
+    logger.error("failed to write file: {}", path);
+    std::exit(1);
+  }
+  return 0;
+}
+
+// Runs args with no shell in between, so that paths are passed as they are,
+// and tells how it failed, or nothing when it exited with 0.
+auto runCompiler(const std::vector<std::string> &args) -> std::string {
+#if __has_include(<sys/wait.h>)
+  auto argv = std::vector<char *>{};
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  auto child = ::fork();
+  if (child < 0) {
+    return "fork failed";
+  }
+  if (child == 0) {
+    ::execvp(argv[0], argv.data());
+    ::_exit(127);
+  }
+  auto status = 0;
+  if (::waitpid(child, &status, 0) != child) {
+    return "wait failed";
+  }
+  if (WIFSIGNALED(status)) {
+    return turing::utils::format("killed by signal {}", WTERMSIG(status));
+  }
+  if (WEXITSTATUS(status) == 127) {
+    return turing::utils::format("cannot run {}", args.front());
+  }
+  if (WEXITSTATUS(status) != 0) {
+    return turing::utils::format("exited with status {}",
+                                 WEXITSTATUS(status));
+  }
+  return {};
+#else
+  // without fork, every argument is quoted for the shell
+  auto command = std::string{};
+  for (const auto &arg : args) {
+    command += command.empty() ? "'" : " '";
+    for (auto ch : arg) {
+      command += ch == '\'' ? std::string{"'\\''"} : std::string(1, ch);
+    }
+    command += '\'';
+  }
+  if (auto status = std::system(command.c_str()); status != 0) {
+    return turing::utils::format("exited with status {}", status);
+  }
+  return {};
+#endif
+}
+
+// Prints the machine as C++, or builds it with the system compiler.
+auto emitNative(Parser &parser) -> int {
+  const auto &logger = Logger::instance();
+  const auto &options = parser.runOptions();
+  if (auto error = parser.parseSource(); error) {
+    exitOnError(error);
+  }
+  if (options.native.empty()) {
+    Emitter(parser.machine(), std::cout).emit();
+    return 0;
+  }
+
+  auto output = std::string{options.native};
+  auto source = output + ".cpp";
+  {
+    auto fs = std::ofstream(source);
+    if (!fs.is_open()) {
+      logger.error("failed to open file: {}", source);
+      std::exit(1);
+    }
+    Emitter(parser.machine(), fs).emit();
+  }
+  // $CXX may bring flags of its own, separated by spaces
+  const auto *compiler = std::getenv("CXX");
+  auto words = turing::utils::split(compiler ? compiler : "c++", ' ');
+  turing::utils::omitEmpty(words);
+  auto args = std::vector<std::string>(words.begin(), words.end());
+  if (args.empty()) {
+    args.emplace_back("c++");
+  }
+  for (const auto *arg : {"-std=c++17", "-O2", "-o"}) {
+    args.emplace_back(arg);
+  }
+  args.push_back(output);
+  args.push_back(source);
+  auto failure = runCompiler(args);
+  std::remove(source.c_str());
+  if (!failure.empty()) {
+    logger.error("failed to compile: {}: {}", turing::utils::join(args, ' '),
+                 failure);
+    std::exit(1);
+  }
+  return 0;
+}
+
+// Prints the profile of the run, and writes it as JSON if asked to.
+auto showProfile(Parser &parser, const Simulator &simulator) -> void {
+  const auto &logger = Logger::instance();
+  const auto *profile = simulator.profiled();
+  if (profile == nullptr) {
+    return;
+  }
+  logger.info(profile->table(parser.machine()));
+  if (auto path = std::string{parser.runOptions().profileJson};
+      !path.empty()) {
+    auto fs = std::ofstream(path);
+    if (!fs.is_open()) {
+      logger.error("failed to open file: {}", path);
+      std::exit(1);
+    }
+    fs << profile->json(parser.machine()) << '\n';
+    if (!fs.flush()) {
+      logger.error("failed to write file: {}", path);
+      std::exit(1);
+    }
+  }
+}
+
+// Steps through a run on the commands read from stdin, see Debugger.
+auto debugRun(Parser &parser) -> int {
+  const auto &options = parser.runOptions();
+  auto program = parser.program().onError(exitOnError);
+  Simulator::of(program, parser.runInput(), options).onError(exitOnError);
+  Debugger(program, parser.runInput(), options).serve(std::cin);
+  return 0;
+}
+
+// Prints the steps of a recorded trace as verbose output would show them.
+auto showTrace(Parser &parser) -> int {
+  const auto &options = parser.runOptions();
+  auto trace = parser.trace().onError(exitOnError);
+  Simulator::replay(trace, options.traceFrom, options.traceTo);
+  return 0;
+}
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+  auto parser = parseArguments(argc, argv);
+
+  if (parser.runOptions().showTrace) {
+    return showTrace(parser);
+  }
+  if (parser.runOptions().debug) {
+    return debugRun(parser);
+  }
+  if (!parser.runOptions().compile.empty()) {
+    return compileImage(parser);
+  }
+  if (!parser.runOptions().dumpOptimized.empty()) {
+    return dumpOptimized(parser);
+  }
+  if (parser.runOptions().emitCpp || !parser.runOptions().native.empty()) {
+    return emitNative(parser);
+  }
+  if (!parser.runOptions().batch.empty()) {
+    return runBatch(parser);
+  }
 
-  simulator.run();
+  auto simulator = parser.parse().onError(exitOnError);
+  auto trace = std::ofstream{};
+  if (auto path = std::string{parser.runOptions().trace}; !path.empty()) {
+    trace.open(path, std::ios::binary);
+    if (!trace.is_open()) {
+      Logger::instance().error("failed to open file: {}", path);
+      std::exit(1);
+    }
+    simulator.traceTo(trace);
+  }
+  auto run = simulator.run();
+  if (trace.is_open() && !trace) {
+    Logger::instance().error("failed to write file: {}",
+                             parser.runOptions().trace);
+    std::exit(1);
+  }
+  showProfile(parser, simulator);
+  if (run.error() == TuringError::SimulatorLimitExceeded) {
+    exitOnError(run.error());
+  } else if (run.error() == TuringError::SimulatorLoops) {
+    // the verdict is printed in place of the result
+    std::exit(run.error().value());
+  }
 
   return 0;
 }